@@ -0,0 +1,28 @@
+#!/bin/bash
+
+# Parses programs nested DEPTH levels deep in several ways and reports the
+# parse time of each; none of them may overflow the native stack.
+# usage: bench/nesting.sh [DEPTH]
+
+depth=${1:-100000}
+target=build/a.out
+dir=$(mktemp -d)
+trap 'rm -rf $dir' EXIT
+
+repeat() {
+  python3 -c "import sys; sys.stdout.write(sys.argv[1] * int(sys.argv[2]))" "$1" $depth
+}
+
+{ echo -n 'int main() { return '; repeat '('; echo -n 1; repeat ')'; echo '; }'; } > $dir/parens.sy
+{ echo -n 'int main() { return '; repeat '- '; echo '1; }'; } > $dir/unary.sy
+{ echo -n 'int main() { return '; repeat '1 + ('; echo -n 1; repeat ')'; echo '; }'; } > $dir/binary.sy
+{ echo 'int f(int x) { return x; }'; echo -n 'int main() { return '; repeat 'f('; echo -n 1; repeat ')'; echo '; }'; } > $dir/calls.sy
+{ echo -n 'int main() '; repeat '{ '; repeat '} '; echo; } > $dir/blocks.sy
+{ echo -n 'int main() { int a = 0; '; repeat 'if (a) a = 1; else '; echo 'a = 2; return a; }'; } > $dir/else-if.sy
+{ echo -n 'int main() { int a = 0; '; repeat 'while (a) '; echo 'a = 1; return a; }'; } > $dir/while.sy
+
+for sy in $dir/*.sy; do
+  name=$(basename $sy .sy)
+  echo $name:
+  $target --parse-only --time $sy 2>&1 | grep parse || echo failed
+done
@@ -1,5 +1,134 @@
-#include <iostream>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
 #include <string>
+#include <string_view>
+
+#include <unistd.h>
+
+// usage: lexer.out [--binary] < input
+//
+// Text output prints one token per line, e.g. `Ident(x)` or `Semicolon`.
+// Binary output (--binary) writes each token as a one-byte tag (its index in
+// `token_names`); Ident and Number are followed by their text as a 32-bit
+// little-endian length and that many bytes.
+
+enum Tag : std::uint8_t {
+  IDENT, NUMBER,
+  IF, ELSE, WHILE, BREAK, CONTINUE, RETURN,
+  ASSIGN, SEMICOLON, LPAR, RPAR, LBRACE, RBRACE,
+  PLUS, MULT, DIV, LT, GT, EQ,
+  ERR
+};
+
+static constexpr const char * token_names[] = {
+  "Ident", "Number",
+  "If", "Else", "While", "Break", "Continue", "Return",
+  "Assign", "Semicolon", "LPar", "RPar", "LBrace", "RBrace",
+  "Plus", "Mult", "Div", "Lt", "Gt", "Eq",
+  "Err"
+};
+
+static constexpr std::size_t buffer_size = std::size_t(1) << 20;
+
+// reads the input in large blocks, with the peek/get interface of std::istream
+struct Input {
+private:
+  std::unique_ptr<char[]> buffer{new char[buffer_size]};
+  std::size_t pos = 0;
+  std::size_t len = 0;
+
+  // takes whatever is available, so a pipe is lexed as it is written
+  bool fill() {
+    pos = 0;
+    ssize_t got; // NOLINT(cppcoreguidelines-init-variables)
+    do got = read(STDIN_FILENO, buffer.get(), buffer_size);
+    while (got < 0 && errno == EINTR);
+    len = got > 0 ? std::size_t(got) : 0;
+    return len != 0;
+  }
+
+public:
+  int peek() {
+    if (pos == len && !fill()) return EOF;
+    return static_cast<unsigned char>(buffer[pos]);
+  }
+  int get() {
+    if (pos == len && !fill()) return EOF;
+    return static_cast<unsigned char>(buffer[pos++]);
+  }
+  bool good() {
+    return peek() != EOF;
+  }
+};
+
+// collects the output in large blocks; never flushes per token
+struct Output {
+private:
+  std::unique_ptr<char[]> buffer{new char[buffer_size]};
+  std::size_t len = 0;
+  bool binary;
+
+  void write(const char * data, std::size_t size) {
+    if (len + size > buffer_size) {
+      flush();
+      if (size > buffer_size) {
+        std::fwrite(data, 1, size, stdout);
+        return;
+      }
+    }
+    std::memcpy(buffer.get() + len, data, size);
+    len += size;
+  }
+  void write(std::string_view text) {
+    write(text.data(), text.size());
+  }
+  void write(char c) {
+    write(&c, 1);
+  }
+
+public:
+  explicit Output(bool binary_) : binary(binary_) {}
+
+  Output(const Output &) = delete;
+  Output & operator=(const Output &) = delete;
+
+  ~Output() {
+    flush();
+  }
+
+  void flush() {
+    std::fwrite(buffer.get(), 1, len, stdout);
+    std::fflush(stdout);
+    len = 0;
+  }
+
+  // `text` is only used by Ident and Number
+  void token(Tag tag, std::string_view text = {}) {
+    if (binary) {
+      write(char(tag));
+      if (tag == IDENT || tag == NUMBER) {
+        auto size = std::uint32_t(text.size());
+        const char bytes[] = {
+          char(size & 0xFF), char((size >> 8) & 0xFF),
+          char((size >> 16) & 0xFF), char((size >> 24) & 0xFF)
+        };
+        write(bytes, sizeof(bytes));
+        write(text);
+      }
+    } else {
+      write(token_names[tag]);
+      if (tag == IDENT || tag == NUMBER) {
+        write('(');
+        write(text);
+        write(')');
+      }
+      write('\n');
+    }
+  }
+};
 
 static bool is_nondigit(int c) {
   return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c == '_');
@@ -10,7 +139,7 @@ static bool is_digit(int c) {
 }
 
 // given the head of an identifier, consume the rest of it and output it
-static int lex_ident(std::istream & in, std::ostream & out, std::string head) {
+static int lex_ident(Input & in, Output & out, std::string head) {
   int c;
   while (true) {
     c = in.peek();
@@ -21,7 +150,7 @@ static int lex_ident(std::istream & in, std::ostream & out, std::string head) {
       break;
     }
   }
-  out << "Ident(" << head << ")" << std::endl;
+  out.token(IDENT, head);
   return 0;
 }
 
@@ -29,7 +158,7 @@ static int lex_ident(std::istream & in, std::ostream & out, std::string head) {
 // if failed, try to consume an identifier instead
 //
 // contract: in.peek() == keyword[0]
-static int lex_keyword(std::istream & in, std::ostream & out, const char * keyword, const char * token) {
+static int lex_keyword(Input & in, Output & out, const char * keyword, Tag token) {
   std::string head;
   head.push_back(char(in.get()));
   for (keyword++; *keyword != '\0'; keyword++) {
@@ -43,101 +172,75 @@ static int lex_keyword(std::istream & in, std::ostream & out, const char * keywo
   // if (is_nondigit(in.peek())) {
   //   return lex_ident(in, out, std::move(head));
   // }
-  out << token << std::endl;
+  out.token(token);
   return 0;
 }
 
 // consume any space plus possibly one token; output that token
-static int lex(std::istream & in, std::ostream & out) {
+static int lex(Input & in, Output & out, std::string & digits) {
   while (true) {
     if (is_nondigit(in.peek())) {
       switch (in.peek()) {
-      case 'i': return lex_keyword(in, out, "if", "If");
-      case 'e': return lex_keyword(in, out, "else", "Else");
-      case 'w': return lex_keyword(in, out, "while", "While");
-      case 'b': return lex_keyword(in, out, "break", "Break");
-      case 'c': return lex_keyword(in, out, "continue", "Continue");
-      case 'r': return lex_keyword(in, out, "return", "Return");
+      case 'i': return lex_keyword(in, out, "if", IF);
+      case 'e': return lex_keyword(in, out, "else", ELSE);
+      case 'w': return lex_keyword(in, out, "while", WHILE);
+      case 'b': return lex_keyword(in, out, "break", BREAK);
+      case 'c': return lex_keyword(in, out, "continue", CONTINUE);
+      case 'r': return lex_keyword(in, out, "return", RETURN);
       default: return lex_ident(in, out, {char(in.get())});
       }
     }
     if (is_digit(in.peek())) {
-      out << "Number(" << char(in.get());
+      digits.assign(1, char(in.get()));
       while (is_digit(in.peek())) {
-        out << char(in.get());
+        digits.push_back(char(in.get()));
       }
-      out << ")" << std::endl;
+      out.token(NUMBER, digits);
       return 0;
     }
     switch (in.peek()) {
     case '=':
       in.get();
       if (in.peek() == '=') {
-        out << "Eq" << std::endl;
+        out.token(EQ);
         in.get();
         return 0;
       } else {
-        out << "Assign" << std::endl;
+        out.token(ASSIGN);
         return 0;
       }
-    case ';':
-      out << "Semicolon" << std::endl;
-      in.get();
-      return 0;
-    case '(':
-      out << "LPar" << std::endl;
-      in.get();
-      return 0;
-    case ')':
-      out << "RPar" << std::endl;
-      in.get();
-      return 0;
-    case '{':
-      out << "LBrace" << std::endl;
-      in.get();
-      return 0;
-    case '}':
-      out << "RBrace" << std::endl;
-      in.get();
-      return 0;
-    case '+':
-      out << "Plus" << std::endl;
-      in.get();
-      return 0;
-    case '*':
-      out << "Mult" << std::endl;
-      in.get();
-      return 0;
-    case '/':
-      out << "Div" << std::endl;
-      in.get();
-      return 0;
-    case '<':
-      out << "Lt" << std::endl;
-      in.get();
-      return 0;
-    case '>':
-      out << "Gt" << std::endl;
-      in.get();
-      return 0;
+    case ';': in.get(); out.token(SEMICOLON); return 0;
+    case '(': in.get(); out.token(LPAR); return 0;
+    case ')': in.get(); out.token(RPAR); return 0;
+    case '{': in.get(); out.token(LBRACE); return 0;
+    case '}': in.get(); out.token(RBRACE); return 0;
+    case '+': in.get(); out.token(PLUS); return 0;
+    case '*': in.get(); out.token(MULT); return 0;
+    case '/': in.get(); out.token(DIV); return 0;
+    case '<': in.get(); out.token(LT); return 0;
+    case '>': in.get(); out.token(GT); return 0;
     case ' ':
     case '\r':
     case '\n':
       in.get();
       return 0;
-    case std::char_traits<char>::eof():
+    case EOF:
       return 0;
     default:
-      out << "Err" << std::endl;
+      out.token(ERR);
       return 1;
     }
   }
 }
 
-int main() {
+int main(int argc, char * argv[]) {
+  bool binary = argc > 1 && std::strcmp(argv[1], "--binary") == 0;
+  Input in;
+  Output out{binary};
+  std::string digits;
   int result = 0;
-  while (std::cin.good()) {
-    result = lex(std::cin, std::cout);
+  while (in.good()) {
+    result = lex(in, out, digits);
     if (result != 0) break;
   }
   return result;
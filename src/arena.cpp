@@ -0,0 +1,27 @@
+#include <algorithm>
+#include <iterator>
+
+#include "arena.hpp"
+
+void Arena::grow(std::size_t size) {
+  std::size_t block_size = std::max(next_block_size, size);
+  held += block_size;
+  next_block_size = std::clamp(held >> growth_shift, first_block_size, max_block_size);
+  blocks.emplace_back(new std::byte[block_size]);
+  cur = blocks.back().get();
+  end = cur + block_size; // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+}
+
+void Arena::adopt(Arena && other) {
+  // keep allocating from our own current block, which stays last
+  blocks.insert(
+    blocks.empty() ? blocks.end() : blocks.end() - 1,
+    std::make_move_iterator(other.blocks.begin()),
+    std::make_move_iterator(other.blocks.end())
+  );
+  held += other.held;
+  other.blocks.clear();
+  other.cur = other.end = nullptr;
+  other.held = 0;
+  other.next_block_size = other.first_block_size;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <ranges>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A bump allocator for objects that live exactly as long as the arena.
+// Objects are never destroyed one by one, so only trivially destructible
+// types may be placed here; everything is released at once with the arena.
+struct Arena {
+private:
+  static constexpr std::size_t default_first_block_size = std::size_t(64) << 10;
+  static constexpr std::size_t max_block_size = std::size_t(16) << 20;
+
+  std::vector<std::unique_ptr<std::byte[]>> blocks;
+  std::byte * cur = nullptr;
+  std::byte * end = nullptr;
+  std::size_t first_block_size = default_first_block_size;
+  std::size_t next_block_size = default_first_block_size;
+  // a new block is as large as the blocks so far, shifted right by this;
+  // a larger shift wastes less room at the end of the last block
+  unsigned growth_shift = 0;
+  std::size_t held = 0;
+
+  // starts a new block with room for at least `size` bytes
+  void grow(std::size_t size);
+
+  inline void * allocate(std::size_t size, std::size_t align) {
+    // NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto addr = reinterpret_cast<std::uintptr_t>(cur);
+    std::size_t pad = (align - addr % align) % align;
+    if (std::size_t(end - cur) < pad + size) {
+      grow(size + align);
+      addr = reinterpret_cast<std::uintptr_t>(cur);
+      pad = (align - addr % align) % align;
+    }
+    // NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+    void * result = cur + pad; // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    cur += pad + size; // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    return result;
+  }
+
+public:
+  Arena() = default;
+  // for arenas that are often small
+  Arena(std::size_t first_block_size, unsigned growth_shift) :
+    first_block_size(first_block_size), next_block_size(first_block_size), growth_shift(growth_shift) {}
+  Arena(const Arena &) = delete;
+  Arena & operator=(const Arena &) = delete;
+  // blocks never move, so pointers into the arena survive moving it
+  Arena(Arena &&) noexcept = default;
+  Arena & operator=(Arena &&) noexcept = default;
+  ~Arena() = default;
+
+  template<typename T, typename... Args>
+  T * make(Args &&... args) {
+    static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+    return ::new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+  }
+
+  // uninitialized room for a `T`, which the caller constructs there and,
+  // unlike the objects from `make`, destroys before the arena goes away
+  template<typename T>
+  void * room_for() {
+    return allocate(sizeof(T), alignof(T));
+  }
+
+  // copies the elements of `items` into the arena
+  template<std::ranges::contiguous_range R>
+  auto make_array(R && items) -> std::span<std::ranges::range_value_t<R>> {
+    using T = std::ranges::range_value_t<R>;
+    static_assert(std::is_trivially_destructible_v<T>, "arena objects are never destroyed");
+    auto count = std::size_t(std::ranges::size(items));
+    if (count == 0) return {};
+    T * data = static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+    std::uninitialized_copy(std::ranges::begin(items), std::ranges::end(items), data);
+    return {data, count};
+  }
+
+  // takes over the blocks of `other`, which is left empty;
+  // objects allocated from either arena now live as long as this one
+  void adopt(Arena && other);
+};
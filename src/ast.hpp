@@ -1,14 +1,19 @@
 #pragma once
 
-#include <memory>
 #include <optional>
-#include <string>
+#include <span>
 #include <variant>
 #include <vector>
 
+#include "arena.hpp"
+#include "intern.hpp"
+
+// Nodes are allocated from the Arena of their Program and refer to each
+// other with plain pointers and spans; the whole tree is freed with it.
+
 namespace ast {
 
-using Ident = std::string;
+using Ident = Sym;
 using Number = int;
 
 enum Type {
@@ -31,20 +36,20 @@ struct Binary {
     LT, LTEQ, GT, GTEQ, EQ, NEQ,
     AND, OR
   } op;
-  std::unique_ptr<Expr> lhs;
-  std::unique_ptr<Expr> rhs;
+  const Expr * lhs;
+  const Expr * rhs;
 };
 
 struct Unary {
   enum Op {
     POS, NEG, NOT
   } op;
-  std::unique_ptr<Expr> operand;
+  const Expr * operand;
 };
 
 struct FuncCall {
   Ident func;
-  std::vector<Expr> args;
+  std::span<const Expr> args;
 };
 
 // Stmt
@@ -75,22 +80,22 @@ struct Return {
   std::optional<Expr> retval;
 };
 
-struct Block : std::vector<Stmt> {};
+struct Block : std::span<const Stmt> {};
 
 struct If {
   Expr cond;
-  std::unique_ptr<Stmt> true_body;
+  const Stmt * true_body;
 };
 
 struct IfElse {
   Expr cond;
-  std::unique_ptr<Stmt> true_body;
-  std::unique_ptr<Stmt> false_body;
+  const Stmt * true_body;
+  const Stmt * false_body;
 };
 
 struct While {
   Expr cond;
-  std::unique_ptr<Stmt> body;
+  const Stmt * body;
 };
 struct Break {};
 struct Continue {};
@@ -103,7 +108,7 @@ struct VarDef {
 struct VarDecl {
   bool is_const;
   Type type;
-  std::vector<VarDef> defs;
+  std::span<const VarDef> defs;
 };
 
 // Global
@@ -116,12 +121,14 @@ struct ArgDef {
 struct Func {
   Type rettype;
   Ident name;
-  std::vector<ArgDef> args;
+  std::span<const ArgDef> args;
   Block body;
 };
 
 using Global = std::variant<Func, VarDecl>;
 
-using Program = std::vector<Global>;
+struct Program : std::vector<Global> {
+  Arena arena;
+};
 
 }
@@ -0,0 +1,33 @@
+#include "call_graph.hpp"
+
+CallGraph::CallGraph(const ir::Program & program) {
+  for (auto & def : program) {
+    auto func = std::get_if<ir::Func>(&def);
+    if (func == nullptr) continue;
+    auto & callees = this->callees[func->name];
+    std::unordered_set<Sym> seen;
+    for (auto & block : func->blocks) {
+      for (auto & instr : block.body) {
+        auto call = std::get_if<ir::Call>(&instr);
+        if (call == nullptr) continue;
+        auto callee = call->func.get<ir::Global>();
+        if (seen.insert(callee).second) callees.push_back(callee);
+      }
+    }
+  }
+}
+
+std::unordered_set<Sym> CallGraph::reachable_from(Sym root) const {
+  std::unordered_set<Sym> result{root};
+  std::vector<Sym> stack{root};
+  while (!stack.empty()) {
+    auto func = stack.back();
+    stack.pop_back();
+    auto it = this->callees.find(func);
+    if (it == this->callees.end()) continue;
+    for (auto callee : it->second) {
+      if (result.insert(callee).second) stack.push_back(callee);
+    }
+  }
+  return result;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "intern.hpp"
+#include "ir.hpp"
+
+// The functions each function of a program calls directly. Callees are
+// found by name, so declared functions appear as callees but have no
+// entry of their own.
+struct CallGraph {
+  // in the order of their first call, each once
+  std::unordered_map<Sym, std::vector<Sym>> callees;
+
+  explicit CallGraph(const ir::Program & program);
+
+  // the functions `root` calls directly or indirectly, `root` included
+  [[nodiscard]] std::unordered_set<Sym> reachable_from(Sym root) const;
+};
@@ -1,9 +1,12 @@
+#include <algorithm>
 #include <iterator>
 #include <ranges>
+#include <utility>
 
 #include "codegen.hpp"
 #include "ir.hpp"
 #include "overloaded.hpp"
+#include "parallel.hpp"
 
 static ir::Type ast_type_to_ir_type(ast::Type type) {
   switch (type) {
@@ -12,22 +15,52 @@ static ir::Type ast_type_to_ir_type(ast::Type type) {
   }
 }
 
+// runtime library functions, declared in the output on first use
+struct Builtin {
+  Sym name;
+  ir::Type rettype;
+  int argc;
+};
+static const Builtin builtins[] = {
+  {intern("getch"), ir::I32, 0},
+  {intern("putch"), ir::VOID, 1},
+  {intern("getint"), ir::I32, 0},
+  {intern("putint"), ir::VOID, 1}
+};
+
+// we can't assign to arguments!
+static Symbol arg_symbol(int i) {
+  return Symbol{Symbol::CONST, ir::I32, 0, ir::Arg{i}};
+}
+
+static Symbol builtin_symbol(const Builtin & builtin) {
+  return Symbol{Symbol::FUNC, builtin.rettype, builtin.argc, ir::Global{builtin.name}};
+}
+
 // initialize global context
-Codegen::Codegen() : scopes{Scope{}} {}
+Codegen::Codegen(CodegenOptions options_) : options(options_), build{options_.fold} {
+  // declaration i is builtins[i]
+  for (auto & builtin : builtins) {
+    this->symbols.declare(builtin.name, builtin_symbol(builtin));
+  }
+  this->symbols.push_scope();
+}
+
+Codegen::Codegen(CodegenOptions options_, const SymbolTable & globals_, std::uint32_t visible_globals_)
+  : Codegen(options_) {
+  this->globals = &globals_;
+  this->visible_globals = visible_globals_;
+}
 
 ir::Program Codegen::get() && {
   ir::Program result;
-  if (this->scopes.front().contains("getch")) {
-    result.emplace_back(ir::FuncDecl{ir::I32, "getch", {}});
-  }
-  if (this->scopes.front().contains("putch")) {
-    result.emplace_back(ir::FuncDecl{ir::VOID, "putch", {ir::I32}});
-  }
-  if (this->scopes.front().contains("getint")) {
-    result.emplace_back(ir::FuncDecl{ir::I32, "getint", {}});
-  }
-  if (this->scopes.front().contains("putint")) {
-    result.emplace_back(ir::FuncDecl{ir::VOID, "putint", {ir::I32}});
+  for (std::uint32_t i = 0; i < std::size(builtins); i++) {
+    auto & builtin = builtins[i];
+    // a global of the same name gets the declaration too
+    if ((this->used_builtins & (1U << i)) != 0 || this->symbols.find(builtin.name) != i) {
+      std::vector<ir::Type> args(std::size_t(builtin.argc), ir::I32);
+      result.emplace_back(ir::FuncDecl{builtin.rettype, builtin.name, std::move(args)});
+    }
   }
   result.insert(
     result.end(),
@@ -38,67 +71,151 @@ ir::Program Codegen::get() && {
   return std::move(result);
 }
 
-void Codegen::add_program(const ast::Program & program) {
-  for (auto & def : program) {
-    std::visit(overloaded {
-      [this](const ast::Func & func) {
-        add_func(func);
+ir::Program Codegen::take_ir() {
+  return std::exchange(this->ir, {});
+}
+
+std::vector<std::pair<Sym, Symbol>> Codegen::take_globals() {
+  std::vector<std::pair<Sym, Symbol>> result;
+  for (auto name : this->new_globals) {
+    result.emplace_back(name, this->symbols[this->symbols.find(name)]);
+  }
+  this->new_globals.clear();
+  return result;
+}
+
+void Codegen::add_globals(const std::vector<std::pair<Sym, Symbol>> & symbols) {
+  for (auto & [name, symbol] : symbols) {
+    auto decl = this->symbols.find(name);
+    if (decl < std::size(builtins) && symbol.kind == Symbol::FUNC
+        && symbol.type == builtins[decl].rettype && symbol.argc == builtins[decl].argc) {
+      // the first use of a builtin, or a function just like it
+      this->used_builtins |= 1U << decl;
+    } else {
+      this->symbols.declare(name, symbol);
+    }
+  }
+}
+
+// Whether a program can have its functions generated in parallel: a global
+// named like a builtin is an error or not depending on whether some function
+// before it used the builtin, which only the serial order tells.
+static bool can_split(const ast::Program & program) {
+  auto is_builtin = [](Sym name) {
+    return std::ranges::any_of(builtins, [name](const Builtin & builtin) { return builtin.name == name; });
+  };
+  return std::ranges::none_of(program, [&is_builtin](const ast::Global & global) {
+    return std::visit(overloaded {
+      [&is_builtin](const ast::Func & func) {
+        return is_builtin(func.name);
       },
-      [this](const ast::VarDecl & decl) {
-        add_var_decl(decl);
+      [&is_builtin](const ast::VarDecl & decl) {
+        return std::ranges::any_of(decl.defs, [&is_builtin](const ast::VarDef & def) { return is_builtin(def.name); });
       }
-    }, def);
-  }
+    }, global);
+  });
 }
 
-void Codegen::add_func(const ast::Func & func) {
-  Scope scope;
-  std::vector<ir::Type> args;
+void Codegen::add_program(const ast::Program & program, unsigned jobs) {
+  if (jobs <= 1 || !can_split(program)) {
+    for (auto & def : program) {
+      add_global(def);
+    }
+    return;
+  }
 
-  // args
-  for (int i = 0; i < func.args.size(); i++) {
-    auto & arg = func.args[i];
-    if (arg.type != ast::INT) throw "unsupported argument type";
-    auto [_, success] = scope.insert({
-      arg.name,
-      // we can't assign to arguments!
-      Symbol{Symbol::CONST, ir::I32, 0, ir::Arg{i}}
-    });
-    if (!success) throw "duplicate argument name";
-    args.push_back(ir::I32);
+  // the code and the first error of each top-level declaration
+  struct Output {
+    ir::Program ir;
+    const char * error = nullptr;
+    // for functions: the global declarations visible in the body
+    std::uint32_t visible_globals = 0;
+    unsigned used_builtins = 0;
+  };
+  std::vector<Output> outputs(program.size());
+
+  // the serial pass: variables, constants and function signatures,
+  // up to the first error
+  std::vector<std::size_t> funcs;
+  for (std::size_t i = 0; i < program.size(); i++) {
+    auto & output = outputs[i];
+    try {
+      std::visit(overloaded {
+        [this, &output, &funcs, i](const ast::Func & func) {
+          declare_func(func.rettype, func.name, func.args);
+          output.visible_globals = this->symbols.size();
+          funcs.push_back(i);
+        },
+        [this, &output](const ast::VarDecl & decl) {
+          add_var_decl(decl);
+          output.ir = take_ir();
+        }
+      }, program[i]);
+    } catch (const char * err) {
+      output.error = err;
+      break;
+    }
   }
 
-  // add func to ir
-  ir::Type rettype = ast_type_to_ir_type(func.rettype);
-  this->ir.emplace_back(ir::Func{
-    rettype,
-    func.name,
-    args,
-    {ir::Block{}}
+  // consecutive functions share a worker; more batches than threads,
+  // since functions differ in size
+  constexpr std::size_t batches_per_job = 4;
+  auto batch_count = std::min(funcs.size(), std::size_t(jobs) * batches_per_job);
+  parallel_for(batch_count, jobs, [&](std::size_t b) {
+    Codegen worker{this->options, this->symbols, 0};
+    for (auto f = funcs.size() * b / batch_count; f < funcs.size() * (b + 1) / batch_count; f++) {
+      auto & output = outputs[funcs[f]];
+      worker.visible_globals = output.visible_globals;
+      worker.used_builtins = 0;
+      try {
+        worker.add_func(std::get<ast::Func>(program[funcs[f]]));
+      } catch (const char * err) {
+        output.error = err;
+        // the worker's state is left mid-function
+        return;
+      }
+      output.ir = worker.take_ir();
+      output.used_builtins = worker.used_builtins;
+    }
   });
 
-  // add func to scope
-  auto [_, success] = get_scope().insert({
-    func.name,
-    Symbol{Symbol::FUNC, rettype, int(args.size()), ir::Global{func.name}}
-  });
-  if (!success) throw "duplicate function name";
+  // merge in source order, stopping at the error the serial order meets first
+  for (auto & output : outputs) {
+    if (output.error != nullptr) throw output.error;
+    for (std::uint32_t b = 0; b < std::size(builtins); b++) {
+      if ((output.used_builtins & ~this->used_builtins & (1U << b)) != 0) {
+        this->used_builtins |= 1U << b;
+        this->new_globals.push_back(builtins[b].name);
+      }
+    }
+    this->ir.insert(
+      this->ir.end(),
+      std::make_move_iterator(output.ir.begin()),
+      std::make_move_iterator(output.ir.end())
+    );
+  }
+}
 
-  // push function scope
-  this->scopes.push_back(std::move(scope));
+void Codegen::add_global(const ast::Global & global) {
+  std::visit(overloaded {
+    [this](const ast::Func & func) {
+      add_func(func);
+    },
+    [this](const ast::VarDecl & decl) {
+      add_var_decl(decl);
+    }
+  }, global);
+}
+
+void Codegen::add_func(const ast::Func & func) {
+  begin_func(func.rettype, func.name, func.args);
 
   // add the function body
   for (auto & stmt : func.body) {
     add_stmt(stmt);
   }
 
-  // remove empty block at the end of function
-  if (get_func().blocks.back().empty()) {
-    get_func().blocks.pop_back();
-  }
-
-  // pop function scope
-  this->scopes.pop_back();
+  end_func();
 }
 
 void Codegen::add_var_decl(const ast::VarDecl & decl) {
@@ -109,44 +226,20 @@ void Codegen::add_var_decl(const ast::VarDecl & decl) {
     if (decl.is_const) {
       for (auto & def : decl.defs) {
         if (!def.init.has_value()) throw "constant must be initialized";
-        auto [_, success] = get_scope().insert({def.name,
-          Symbol{
-            Symbol::CONST,
-            ir::I32,
-            0,
-            ir::Const{eval_constexpr(def.init.value())}
-          }
-        });
-        if (!success) throw "redeclared constant";
+        declare_const(def.name, eval_constexpr(def.init.value()));
       }
     } else {
-      if (this->scopes.size() == 1) {
+      if (at_global_scope()) {
         // if global
         for (auto & def : decl.defs) {
-          this->ir.emplace_back(ir::GlobalVar{
-            def.name,
-            ir::I32,
-            def.init.has_value()
-            ? eval_constexpr(def.init.value())
-            : 0
-          });
-          auto [_, success] = get_scope().insert(
-            {def.name, Symbol{Symbol::VAR, ir::I32, 0, ir::Global{def.name}}}
-          );
-          if (!success) throw "redeclared variable";
+          declare_global(def.name, def.init.has_value() ? eval_constexpr(def.init.value()) : 0);
         }
       } else {
         // if in block
-        auto block = get_block();
         for (auto & def : decl.defs) {
-          auto var = block->push_back(ir::Alloca{ir::I32});
-          auto [_, success] = get_scope().insert(
-            {def.name, Symbol{Symbol::VAR, ir::I32, 0, var}}
-          );
-          if (!success) throw "redeclared variable";
+          auto var = declare_local(def.name);
           if (def.init.has_value()) {
-            auto result = cast(add_expr(def.init.value()), ir::I32);
-            block->push_back(ir::Store{ir::I32, result, var});
+            assign(var, cast(add_expr(def.init.value()), ir::I32));
           }
         }
       }
@@ -158,120 +251,47 @@ void Codegen::add_stmt(const ast::Stmt & stmt) {
   std::visit(overloaded {
     [this](std::monostate _) { /* noop */ },
     [this](const ast::If & stmt) {
-      auto & func = get_func();
-
-      // cond block
-      auto cond = cast(add_expr(stmt.cond), ir::I1);
-      auto cond_end = --func.blocks.end();
-
-      // body block
-      auto body_begin = func.new_block();
+      auto context = begin_if(add_cond(stmt.cond));
       add_stmt(*stmt.true_body);
-      auto body_end = --func.blocks.end();
-
-      // after block
-      auto after_if = func.new_block();
-
-      // add branches
-      cond_end->terminator = ir::BrCond{cond, body_begin, after_if};
-      body_end->terminator = ir::Br{after_if};
+      end_if(context);
     },
     [this](const ast::IfElse & stmt) {
-      auto & func = get_func();
-
-      // cond block
-      auto cond = cast(add_expr(stmt.cond), ir::I1);
-      auto cond_end = --func.blocks.end();
-
-      // true block
-      auto true_begin = func.new_block();
+      auto context = begin_if(add_cond(stmt.cond));
       add_stmt(*stmt.true_body);
-      auto true_end = --func.blocks.end();
-
-      // false block
-      auto false_begin = func.new_block();
+      begin_else(context);
       add_stmt(*stmt.false_body);
-      auto false_end = --func.blocks.end();
-
-      // after block
-      auto after_if = func.new_block();
-
-      // add branches
-      cond_end->terminator = ir::BrCond{cond, true_begin, false_begin};
-      true_end->terminator = ir::Br{after_if};
-      false_end->terminator = ir::Br{after_if};
+      end_if_else(context);
     },
     [this](const ast::While & stmt) {
-      auto & func = get_func();
-
-      // before block
-      auto before_loop = --func.blocks.end();
-
-      // cond block
-      auto cond_begin = func.new_block();
-      auto cond = cast(add_expr(stmt.cond), ir::I1);
-      auto cond_end = --func.blocks.end();
-
-      // body block
-      auto body_begin = func.new_block();
-      this->loop_contexts.push_back(LoopContext{cond_begin});
+      auto context = begin_while();
+      begin_while_body(context, add_cond(stmt.cond));
       add_stmt(*stmt.body);
-      auto body_end = --func.blocks.end();
-
-      // after block
-      auto after_loop = func.new_block();
-
-      // add conditional branch and fix breaks
-      before_loop->terminator = ir::Br{cond_begin};
-      cond_end->terminator = ir::BrCond{cond, body_begin, after_loop};
-      for (auto break_block : this->loop_contexts.back().breaks) {
-        break_block->terminator = ir::Br{after_loop};
-      }
-      this->loop_contexts.pop_back();
-      body_end->terminator = ir::Br{cond_begin};
+      end_while(context);
     },
     [this](const ast::Block & block) {
-      this->scopes.emplace_back();
+      this->symbols.push_scope();
       for (auto & stmt : block) {
         add_stmt(stmt);
       }
-      this->scopes.pop_back();
+      this->symbols.pop_scope();
     },
     [this](const ast::Assign & stmt) {
-      auto & symbol = get_symbol(stmt.var);
-      if (symbol.kind != Symbol::VAR) throw "can't assign to constant or function";
-      get_block()->push_back(ir::Store{
-        symbol.type,
-        cast(add_expr(stmt.value), symbol.type),
-        symbol.ir
-      });
+      auto & symbol = get_assignee(stmt.var);
+      assign(symbol, cast(add_expr(stmt.value), symbol.type));
     },
     [this](const ast::Return & stmt) {
+      check_return(stmt.retval.has_value());
       if (stmt.retval.has_value()) {
-        if (get_func().rettype != ir::I32) {
-          throw "can't return a value from a function with rettype void";
-        }
-        get_block()->terminator = ir::Ret{
-          ir::I32,
-          cast(add_expr(stmt.retval.value()), ir::I32)
-        };
+        add_return(add_expr(stmt.retval.value()));
       } else {
-        if (get_func().rettype != ir::VOID) {
-          throw "can't return without a value from a function with rettype int";
-        }
-        get_block()->terminator = ir::Ret{ir::VOID};
+        add_return();
       }
-      get_func().new_block();
     },
     [this](const ast::Break & _) {
-      auto & context = get_loop_context();
-      context.breaks.push_back(get_block());
-      get_func().new_block();
+      add_break();
     },
     [this](const ast::Continue & _) {
-      auto & context = get_loop_context();
-      get_block()->terminator = ir::Br{context.loop_begin};
-      get_func().new_block();
+      add_continue();
     },
     [this](const ast::Expr & expr) {
       add_expr(expr);
@@ -282,144 +302,53 @@ void Codegen::add_stmt(const ast::Stmt & stmt) {
   }, stmt);
 }
 
+struct BinaryOp {
+  ir::Binary::Op op;
+  ir::Type operand_type;
+  ir::Type result_type;
+};
+
+static BinaryOp binary_op(ast::Binary::Op op) {
+  switch (op) {
+  case ast::Binary::PLUS: return {ir::Binary::ADD, ir::I32, ir::I32};
+  case ast::Binary::MINUS: return {ir::Binary::SUB, ir::I32, ir::I32};
+  case ast::Binary::MULT: return {ir::Binary::MUL, ir::I32, ir::I32};
+  case ast::Binary::DIV: return {ir::Binary::SDIV, ir::I32, ir::I32};
+  case ast::Binary::MOD: return {ir::Binary::SREM, ir::I32, ir::I32};
+  case ast::Binary::LT: return {ir::Binary::ICMP_SLT, ir::I32, ir::I1};
+  case ast::Binary::LTEQ: return {ir::Binary::ICMP_SLE, ir::I32, ir::I1};
+  case ast::Binary::GT: return {ir::Binary::ICMP_SGT, ir::I32, ir::I1};
+  case ast::Binary::GTEQ: return {ir::Binary::ICMP_SGE, ir::I32, ir::I1};
+  case ast::Binary::EQ: return {ir::Binary::ICMP_EQ, ir::I32, ir::I1};
+  case ast::Binary::NEQ: return {ir::Binary::ICMP_NE, ir::I32, ir::I1};
+  case ast::Binary::AND: return {ir::Binary::AND, ir::I1, ir::I1};
+  case ast::Binary::OR: return {ir::Binary::OR, ir::I1, ir::I1};
+  }
+}
+
 TypedOperand Codegen::add_expr(const ast::Expr & expr) {
   return std::visit(overloaded {
     [this](const ast::Binary & expr) {
-      // NOLINTBEGIN(cppcoreguidelines-init-variables)
-      ir::Binary::Op op;
-      ir::Type operand_type;
-      ir::Type result_type;
-      // NOLINTEND(cppcoreguidelines-init-variables)
-      switch (expr.op) {
-      case ast::Binary::PLUS:
-        op = ir::Binary::ADD;
-        operand_type = ir::I32;
-        result_type = ir::I32;
-        break;
-      case ast::Binary::MINUS:
-        op = ir::Binary::SUB;
-        operand_type = ir::I32;
-        result_type = ir::I32;
-        break;
-      case ast::Binary::MULT:
-        op = ir::Binary::MUL;
-        operand_type = ir::I32;
-        result_type = ir::I32;
-        break;
-      case ast::Binary::DIV:
-        op = ir::Binary::SDIV;
-        operand_type = ir::I32;
-        result_type = ir::I32;
-        break;
-      case ast::Binary::MOD:
-        op = ir::Binary::SREM;
-        operand_type = ir::I32;
-        result_type = ir::I32;
-        break;
-      case ast::Binary::LT:
-        op = ir::Binary::ICMP_SLT;
-        operand_type = ir::I32;
-        result_type = ir::I1;
-        break;
-      case ast::Binary::LTEQ:
-        op = ir::Binary::ICMP_SLE;
-        operand_type = ir::I32;
-        result_type = ir::I1;
-        break;
-      case ast::Binary::GT:
-        op = ir::Binary::ICMP_SGT;
-        operand_type = ir::I32;
-        result_type = ir::I1;
-        break;
-      case ast::Binary::GTEQ:
-        op = ir::Binary::ICMP_SGE;
-        operand_type = ir::I32;
-        result_type = ir::I1;
-        break;
-      case ast::Binary::EQ:
-        op = ir::Binary::ICMP_EQ;
-        operand_type = ir::I32;
-        result_type = ir::I1;
-        break;
-      case ast::Binary::NEQ:
-        op = ir::Binary::ICMP_NE;
-        operand_type = ir::I32;
-        result_type = ir::I1;
-        break;
-      case ast::Binary::AND:
-        op = ir::Binary::AND;
-        operand_type = ir::I1;
-        result_type = ir::I1;
-        break;
-      case ast::Binary::OR:
-        op = ir::Binary::OR;
-        operand_type = ir::I1;
-        result_type = ir::I1;
-        break;
-      }
-      auto lhs = cast(add_expr(*expr.lhs), operand_type);
-      auto rhs = cast(add_expr(*expr.rhs), operand_type);
-      auto vreg = get_block()->push_back(ir::Binary{op, operand_type, lhs, rhs});
-      return TypedOperand{result_type, vreg};
+      auto op = binary_op(expr.op);
+      auto lhs = cast(add_expr(*expr.lhs), op.operand_type);
+      auto rhs = cast(add_expr(*expr.rhs), op.operand_type);
+      auto vreg = this->build.binary(*get_block(), op.op, op.operand_type, lhs, rhs);
+      return TypedOperand{op.result_type, vreg};
     },
     [this](const ast::Unary & expr) {
-      switch (expr.op) {
-      case ast::Unary::POS:
-        return TypedOperand{ir::I32, cast(add_expr(*expr.operand), ir::I32)};
-      case ast::Unary::NEG:
-      {
-        auto operand = cast(add_expr(*expr.operand), ir::I32);
-        auto vreg = get_block()->push_back(ir::Binary{
-          ir::Binary::SUB,
-          ir::I32,
-          ir::Const{0},
-          operand
-        });
-        return TypedOperand{ir::I32, vreg};
-      }
-      case ast::Unary::NOT:
-      {
-        auto operand = add_expr(*expr.operand);
-        auto vreg = get_block()->push_back(ir::Binary{
-          ir::Binary::ICMP_EQ,
-          operand.type,
-          operand.inner,
-          ir::Const{0}
-        });
-        return TypedOperand{ir::I1, vreg};
-      }
-      }
+      return add_unary(expr.op, add_expr(*expr.operand));
     },
     [this](const ast::FuncCall & expr) {
-      auto & symbol = get_symbol(expr.func);
-      if (symbol.kind != Symbol::FUNC) throw "variable used as a function";
-      if (expr.args.size() != symbol.argc) throw "mismatched number of arguments";
-      std::vector<std::pair<ir::Type, ir::Operand>> args;
+      auto & symbol = get_callee(expr.func, expr.args.size());
+      std::vector<std::pair<ir::Type, ir::Use>> args;
       args.reserve(expr.args.size());
       for (auto & arg : expr.args) {
         args.emplace_back(ir::I32, cast(add_expr(arg), ir::I32));
       }
-      auto vreg = get_block()->push_back(ir::Call{
-        symbol.type,
-        symbol.ir,
-        std::move(args)
-      });
-      return TypedOperand{symbol.type, vreg};
+      return add_call(symbol, std::move(args));
     },
     [this](const ast::Ident & ident) {
-      auto & symbol = get_symbol(ident);
-      switch (symbol.kind) {
-      case Symbol::CONST: return TypedOperand{symbol.type, symbol.ir};
-      case Symbol::VAR:
-      {
-        auto vreg = get_block()->push_back(ir::Load{
-          symbol.type,
-          symbol.ir
-        });
-        return TypedOperand{symbol.type, vreg};
-      }
-      case Symbol::FUNC: throw "function used as a variable";
-      }
+      return add_ident(ident);
     },
     [](int number) {
       return TypedOperand{ir::I32, ir::Const{number}};
@@ -427,18 +356,597 @@ TypedOperand Codegen::add_expr(const ast::Expr & expr) {
   }, expr);
 }
 
+// the flat AST
+
+// a compound statement whose body is being generated
+struct FlatFrame {
+  std::uint32_t node;
+  BranchContext context;
+};
+
+void Codegen::add_program(const ast::FlatProgram & program) {
+  using ast::FlatStmts;
+  auto & stmts = program.stmts;
+  std::vector<FlatFrame> frames;
+  for (std::uint32_t i = 0; i <= stmts.size(); i++) {
+    // finish the statements that end here, innermost first
+    while (!frames.empty() && stmts.ends[frames.back().node] == i) {
+      auto & frame = frames.back();
+      switch (stmts.tags[frame.node]) {
+      case FlatStmts::IF: end_if(frame.context); break;
+      case FlatStmts::IF_ELSE: end_if_else(frame.context); break;
+      case FlatStmts::WHILE: end_while(frame.context); break;
+      case FlatStmts::BLOCK: this->symbols.pop_scope(); break;
+      case FlatStmts::FUNC: end_func(); break;
+      default: break;
+      }
+      frames.pop_back();
+    }
+    if (i == stmts.size()) break;
+    if (!frames.empty() && stmts.tags[frames.back().node] == FlatStmts::IF_ELSE) {
+      auto & frame = frames.back();
+      if (stmts.values[frame.node] == i) begin_else(frame.context);
+    }
+
+    auto expr = stmts.exprs[i];
+    switch (stmts.tags[i]) {
+    case FlatStmts::EMPTY:
+      break;
+    case FlatStmts::IF:
+    case FlatStmts::IF_ELSE:
+      frames.push_back(FlatFrame{i, begin_if(add_cond(program, expr))});
+      break;
+    case FlatStmts::WHILE:
+    {
+      auto context = begin_while();
+      begin_while_body(context, add_cond(program, expr));
+      frames.push_back(FlatFrame{i, std::move(context)});
+      break;
+    }
+    case FlatStmts::BLOCK:
+      this->symbols.push_scope();
+      frames.push_back(FlatFrame{i, {}});
+      break;
+    case FlatStmts::ASSIGN:
+    {
+      auto & symbol = get_assignee(Sym{stmts.values[i]});
+      assign(symbol, cast(add_expr(program, expr), symbol.type));
+      break;
+    }
+    case FlatStmts::RETURN:
+      check_return(expr != ast::no_node);
+      if (expr != ast::no_node) {
+        add_return(add_expr(program, expr));
+      } else {
+        add_return();
+      }
+      break;
+    case FlatStmts::BREAK:
+      add_break();
+      break;
+    case FlatStmts::CONTINUE:
+      add_continue();
+      break;
+    case FlatStmts::EXPR:
+      add_expr(program, expr);
+      break;
+    case FlatStmts::VAR_DECL:
+      add_var_decl(program, stmts.values[i]);
+      break;
+    case FlatStmts::FUNC:
+    {
+      auto func = stmts.values[i];
+      auto & funcs = program.funcs;
+      begin_func(
+        funcs.rettypes[func],
+        funcs.names[func],
+        std::span(program.args).subspan(funcs.first_args[func], funcs.arg_counts[func])
+      );
+      frames.push_back(FlatFrame{i, {}});
+      break;
+    }
+    }
+  }
+}
+
+void Codegen::add_var_decl(const ast::FlatProgram & program, std::uint32_t decl) {
+  auto & decls = program.decls;
+  auto & defs = program.defs;
+  auto first = decls.first_defs[decl];
+  auto last = first + decls.def_counts[decl];
+  switch (decls.types[decl]) {
+  case ast::Type::VOID:
+    throw "variables can't be void";
+  case ast::Type::INT:
+    if (decls.is_const[decl] != 0) {
+      for (auto def = first; def < last; def++) {
+        if (defs.inits[def] == ast::no_node) throw "constant must be initialized";
+        declare_const(defs.names[def], eval_constexpr(program, defs.inits[def]));
+      }
+    } else {
+      if (at_global_scope()) {
+        // if global
+        for (auto def = first; def < last; def++) {
+          auto init = defs.inits[def];
+          declare_global(defs.names[def], init != ast::no_node ? eval_constexpr(program, init) : 0);
+        }
+      } else {
+        // if in block
+        for (auto def = first; def < last; def++) {
+          auto var = declare_local(defs.names[def]);
+          if (defs.inits[def] != ast::no_node) {
+            assign(var, cast(add_expr(program, defs.inits[def]), ir::I32));
+          }
+        }
+      }
+    }
+  }
+}
+
+// A linear scan over the nodes of the expression, with an operand stack.
+TypedOperand Codegen::add_expr(const ast::FlatProgram & program, std::uint32_t root) {
+  using ast::FlatExprs;
+  auto & exprs = program.exprs;
+  auto & operands = this->operands;
+  auto & callees = this->callees;
+  operands.clear();
+  for (auto i = exprs.first(root); i <= root; i++) {
+    TypedOperand result;
+    switch (exprs.tags[i]) {
+    case FlatExprs::NUMBER:
+      result = TypedOperand{ir::I32, ir::Const{int(exprs.values[i])}};
+      break;
+    case FlatExprs::IDENT:
+      result = add_ident(Sym{exprs.values[i]});
+      break;
+    case FlatExprs::UNARY:
+    {
+      auto operand = operands.back();
+      operands.pop_back();
+      result = add_unary(ast::Unary::Op(exprs.ops[i]), std::move(operand));
+      break;
+    }
+    case FlatExprs::BINARY:
+    {
+      auto op = binary_op(ast::Binary::Op(exprs.ops[i]));
+      auto rhs = cast(std::move(operands.back()), op.operand_type);
+      operands.pop_back();
+      auto lhs = operands.back().inner;
+      operands.pop_back();
+      auto vreg = this->build.binary(*get_block(), op.op, op.operand_type, lhs, rhs);
+      result = TypedOperand{op.result_type, vreg};
+      break;
+    }
+    case FlatExprs::CALLEE:
+      callees.push_back(&get_callee(Sym{exprs.values[i]}, exprs.values[exprs.parents[i]]));
+      continue;
+    case FlatExprs::CALL:
+    {
+      std::vector<std::pair<ir::Type, ir::Use>> args;
+      args.reserve(exprs.values[i]);
+      for (auto arg = operands.end() - exprs.values[i]; arg != operands.end(); arg++) {
+        args.emplace_back(ir::I32, arg->inner);
+      }
+      operands.resize(operands.size() - exprs.values[i]);
+      result = add_call(*callees.back(), std::move(args));
+      callees.pop_back();
+      break;
+    }
+    }
+    // like the tree, cast a lhs or an argument before the code of the next operand
+    auto parent = exprs.parents[i];
+    if (parent != ast::no_node && exprs.tags[parent] == FlatExprs::CALL) {
+      result = TypedOperand{ir::I32, cast(std::move(result), ir::I32)};
+    } else if (parent != ast::no_node && exprs.tags[parent] == FlatExprs::BINARY && parent != i + 1) {
+      auto type = binary_op(ast::Binary::Op(exprs.ops[parent])).operand_type;
+      result = TypedOperand{type, cast(std::move(result), type)};
+    }
+    operands.push_back(result);
+  }
+  return operands.back();
+}
+
+// shared by both forms of the AST
+
+void Codegen::declare_func(ast::Type rettype, ast::Ident name, std::span<const ast::ArgDef> args) {
+  // args, checked before the function name in a scope of their own
+  this->symbols.push_scope();
+  for (int i = 0; i < args.size(); i++) {
+    auto & arg = args[i];
+    if (arg.type != ast::INT) throw "unsupported argument type";
+    if (!declare(arg.name, arg_symbol(i))) throw "duplicate argument name";
+  }
+  this->symbols.pop_scope();
+
+  // add func to scope
+  auto symbol = Symbol{Symbol::FUNC, ast_type_to_ir_type(rettype), int(args.size()), ir::Global{name}};
+  if (!declare(name, std::move(symbol))) throw "duplicate function name";
+}
+
+void Codegen::begin_func(ast::Type rettype, ast::Ident name, std::span<const ast::ArgDef> args) {
+  // a worker's function was declared by the serial pass
+  if (this->globals == nullptr) declare_func(rettype, name, args);
+
+  // add func to ir
+  this->ir.emplace_back(ir::Func{
+    ast_type_to_ir_type(rettype),
+    name,
+    std::vector<ir::Type>(args.size(), ir::I32),
+  });
+  get_func().new_block();
+
+  if (this->options.ssa) {
+    this->ssa.clear();
+    this->ssa.seal(get_block(), {});
+  }
+
+  // push function scope
+  this->symbols.push_scope();
+  for (int i = 0; i < args.size(); i++) {
+    declare(args[i].name, arg_symbol(i));
+  }
+}
+
+void Codegen::end_func() {
+  if (this->options.ssa) this->ssa.finish();
+
+  // remove empty block at the end of function
+  if (get_func().blocks.back().empty()) {
+    get_func().blocks.pop_back();
+  }
+
+  // pop function scope
+  this->symbols.pop_scope();
+}
+
+bool Codegen::declare(Sym name, Symbol && symbol) {
+  if (at_global_scope()) {
+    // a builtin is a global once it is used
+    auto decl = this->symbols.find(name);
+    if (decl < std::size(builtins) && (this->used_builtins & (1U << decl)) != 0) return false;
+    if (!this->symbols.declare(name, symbol)) return false;
+    this->new_globals.push_back(name);
+    return true;
+  }
+  return this->symbols.declare(name, symbol);
+}
+
+void Codegen::declare_const(ast::Ident name, int value) {
+  if (!declare(name, Symbol{Symbol::CONST, ir::I32, 0, ir::Const{value}})) {
+    throw "redeclared constant";
+  }
+}
+
+void Codegen::declare_global(ast::Ident name, int value) {
+  this->ir.emplace_back(ir::GlobalVar{name, ir::I32, value});
+  if (!declare(name, Symbol{Symbol::VAR, ir::I32, 0, ir::Global{name}})) {
+    throw "redeclared variable";
+  }
+}
+
+Symbol Codegen::declare_local(ast::Ident name) {
+  Symbol symbol;
+  if (this->options.ssa) {
+    // like memory after mem2reg, a variable is 0 until it is assigned
+    symbol = Symbol{Symbol::LOCAL, ir::I32, 0, ir::Const{0}, this->ssa.new_var()};
+    this->ssa.write(symbol.local, get_block(), ir::Const{0});
+  } else {
+    symbol = Symbol{Symbol::VAR, ir::I32, 0, get_block()->push_back(ir::Alloca{ir::I32})};
+  }
+  if (!declare(name, Symbol{symbol})) {
+    throw "redeclared variable";
+  }
+  return symbol;
+}
+
+void Codegen::assign(const Symbol & var, ir::Operand value) {
+  if (var.kind == Symbol::LOCAL) {
+    this->ssa.write(var.local, get_block(), value);
+  } else {
+    get_block()->push_back(ir::Store{var.type, value, var.ir});
+  }
+}
+
+// a block whose predecessors are all known
+ir::Label Codegen::new_block(std::vector<ir::Label> && preds) {
+  auto block = get_func().new_block();
+  if (this->options.ssa) this->ssa.seal(block, std::move(preds));
+  return block;
+}
+
+// the blocks `jumps` branch from
+static std::vector<ir::Label> sources(const std::vector<Jump> & jumps) {
+  std::vector<ir::Label> result;
+  result.reserve(jumps.size());
+  for (auto & jump : jumps) {
+    result.push_back(jump.from);
+  }
+  return result;
+}
+
+// sets the branch targets in `jumps` to `label`
+static void patch(std::vector<Jump> & jumps, ir::Label label) {
+  for (auto & jump : jumps) {
+    *jump.target = label;
+  }
+  jumps.clear();
+}
+
+static void append(std::vector<Jump> & to, const std::vector<Jump> & from) {
+  to.insert(to.end(), from.begin(), from.end());
+}
+
+CondJumps Codegen::add_cond(const ast::Expr & cond) {
+  if (this->options.short_circuit) {
+    if (auto binary = std::get_if<ast::Binary>(&cond); binary != nullptr
+      && (binary->op == ast::Binary::AND || binary->op == ast::Binary::OR)) {
+      auto jumps = add_cond(*binary->lhs);
+      begin_rhs(binary->op, jumps);
+      auto rhs = add_cond(*binary->rhs);
+      append(jumps.if_true, rhs.if_true);
+      append(jumps.if_false, rhs.if_false);
+      return jumps;
+    }
+    if (auto unary = std::get_if<ast::Unary>(&cond); unary != nullptr && unary->op == ast::Unary::NOT) {
+      auto jumps = add_cond(*unary->operand);
+      std::swap(jumps.if_true, jumps.if_false);
+      return jumps;
+    }
+  }
+  return add_branch(add_expr(cond));
+}
+
+CondJumps Codegen::add_cond(const ast::FlatProgram & program, std::uint32_t root) {
+  using ast::FlatExprs;
+  auto & exprs = program.exprs;
+  if (this->options.short_circuit) {
+    auto op = exprs.ops[root];
+    if (exprs.tags[root] == FlatExprs::BINARY && (op == ast::Binary::AND || op == ast::Binary::OR)) {
+      auto jumps = add_cond(program, exprs.lhs(root));
+      begin_rhs(ast::Binary::Op(op), jumps);
+      auto rhs = add_cond(program, root - 1);
+      append(jumps.if_true, rhs.if_true);
+      append(jumps.if_false, rhs.if_false);
+      return jumps;
+    }
+    if (exprs.tags[root] == FlatExprs::UNARY && op == ast::Unary::NOT) {
+      auto jumps = add_cond(program, root - 1);
+      std::swap(jumps.if_true, jumps.if_false);
+      return jumps;
+    }
+  }
+  return add_branch(add_expr(program, root));
+}
+
+// the rhs of && runs when the lhs is true, and the rhs of || when it is false
+void Codegen::begin_rhs(ast::Binary::Op op, CondJumps & lhs) {
+  auto & jumps = op == ast::Binary::AND ? lhs.if_true : lhs.if_false;
+  patch(jumps, new_block(sources(jumps)));
+}
+
+// ends the current block with a branch on `cond`
+CondJumps Codegen::add_branch(TypedOperand && cond) {
+  auto value = cast(std::move(cond), ir::I1);
+  auto block = get_block();
+  block->terminator = this->build.br_cond(value, nullptr, nullptr);
+  CondJumps jumps;
+  if (auto br = std::get_if<ir::Br>(&block->terminator)) {
+    // folded, so `value` is a constant
+    (value.get<ir::Const>().value != 0 ? jumps.if_true : jumps.if_false).push_back(Jump{block, &br->dest});
+  } else {
+    auto & br_cond = std::get<ir::BrCond>(block->terminator);
+    jumps.if_true.push_back(Jump{block, &br_cond.iftrue});
+    jumps.if_false.push_back(Jump{block, &br_cond.iffalse});
+  }
+  return jumps;
+}
+
+BranchContext Codegen::begin_if(CondJumps && cond) {
+  BranchContext context{};
+
+  // body block
+  patch(cond.if_true, new_block(sources(cond.if_true)));
+  context.cond_false = std::move(cond.if_false);
+  return context;
+}
+
+void Codegen::begin_else(BranchContext & context) {
+  auto & func = get_func();
+  context.true_end = &func.blocks.back();
+
+  // false block
+  context.false_begin = new_block(sources(context.cond_false));
+  patch(context.cond_false, context.false_begin);
+}
+
+void Codegen::end_if(BranchContext & context) {
+  auto & func = get_func();
+  auto body_end = &func.blocks.back();
+
+  // after block
+  auto preds = sources(context.cond_false);
+  preds.push_back(body_end);
+  auto after_if = new_block(std::move(preds));
+
+  // add branches
+  patch(context.cond_false, after_if);
+  body_end->terminator = ir::Br{after_if};
+}
+
+void Codegen::end_if_else(BranchContext & context) {
+  auto & func = get_func();
+  auto false_end = &func.blocks.back();
+
+  // after block
+  auto after_if = new_block({context.true_end, false_end});
+
+  // add branches
+  context.true_end->terminator = ir::Br{after_if};
+  false_end->terminator = ir::Br{after_if};
+}
+
+BranchContext Codegen::begin_while() {
+  auto & func = get_func();
+  BranchContext context{};
+
+  // before block
+  context.before_loop = &func.blocks.back();
+
+  // cond block, sealed once the body is done
+  context.cond_begin = func.new_block();
+  context.before_loop->terminator = ir::Br{context.cond_begin};
+  return context;
+}
+
+void Codegen::begin_while_body(BranchContext & context, CondJumps && cond) {
+  // body block
+  patch(cond.if_true, new_block(sources(cond.if_true)));
+  context.cond_false = std::move(cond.if_false);
+  this->loop_contexts.push_back(LoopContext{context.cond_begin});
+}
+
+void Codegen::end_while(BranchContext & context) {
+  auto & func = get_func();
+  auto body_end = &func.blocks.back();
+  auto & loop = this->loop_contexts.back();
+
+  if (this->options.ssa) {
+    auto preds = loop.continues;
+    preds.push_back(context.before_loop);
+    preds.push_back(body_end);
+    this->ssa.seal(context.cond_begin, std::move(preds));
+  }
+
+  // after block
+  auto preds = sources(context.cond_false);
+  preds.insert(preds.end(), loop.breaks.begin(), loop.breaks.end());
+  auto after_loop = new_block(std::move(preds));
+
+  // add conditional branch and fix breaks
+  patch(context.cond_false, after_loop);
+  for (auto break_block : loop.breaks) {
+    break_block->terminator = ir::Br{after_loop};
+  }
+  this->loop_contexts.pop_back();
+  body_end->terminator = ir::Br{context.cond_begin};
+}
+
+const Symbol & Codegen::get_assignee(ast::Ident var) {
+  auto & symbol = get_symbol(var);
+  if (symbol.kind != Symbol::VAR && symbol.kind != Symbol::LOCAL) throw "can't assign to constant or function";
+  return symbol;
+}
+
+void Codegen::check_return(bool has_value) {
+  if (has_value && get_func().rettype != ir::I32) {
+    throw "can't return a value from a function with rettype void";
+  }
+  if (!has_value && get_func().rettype != ir::VOID) {
+    throw "can't return without a value from a function with rettype int";
+  }
+}
+
+void Codegen::add_return(TypedOperand && retval) {
+  get_block()->terminator = ir::Ret{
+    ir::I32,
+    cast(std::move(retval), ir::I32)
+  };
+  new_block({});
+}
+
+void Codegen::add_return() {
+  get_block()->terminator = ir::Ret{ir::VOID};
+  new_block({});
+}
+
+void Codegen::add_break() {
+  auto & context = get_loop_context();
+  context.breaks.push_back(get_block());
+  new_block({});
+}
+
+void Codegen::add_continue() {
+  auto & context = get_loop_context();
+  context.continues.push_back(get_block());
+  get_block()->terminator = ir::Br{context.loop_begin};
+  new_block({});
+}
+
+TypedOperand Codegen::add_unary(ast::Unary::Op op, TypedOperand && operand) {
+  switch (op) {
+  case ast::Unary::POS:
+    return TypedOperand{ir::I32, cast(std::move(operand), ir::I32)};
+  case ast::Unary::NEG:
+  {
+    auto vreg = this->build.binary(
+      *get_block(),
+      ir::Binary::SUB,
+      ir::I32,
+      ir::Const{0},
+      cast(std::move(operand), ir::I32)
+    );
+    return TypedOperand{ir::I32, vreg};
+  }
+  case ast::Unary::NOT:
+  {
+    auto vreg = this->build.binary(
+      *get_block(),
+      ir::Binary::ICMP_EQ,
+      operand.type,
+      operand.inner,
+      ir::Const{0}
+    );
+    return TypedOperand{ir::I1, vreg};
+  }
+  }
+}
+
+const Symbol & Codegen::get_callee(ast::Ident func, std::size_t argc) {
+  auto & symbol = get_symbol(func);
+  if (symbol.kind != Symbol::FUNC) throw "variable used as a function";
+  if (argc != symbol.argc) throw "mismatched number of arguments";
+  return symbol;
+}
+
+TypedOperand Codegen::add_call(const Symbol & callee, std::vector<std::pair<ir::Type, ir::Use>> && args) {
+  auto vreg = get_block()->push_back(ir::Call{
+    callee.type,
+    callee.ir,
+    std::move(args)
+  });
+  return TypedOperand{callee.type, vreg};
+}
+
+TypedOperand Codegen::add_ident(ast::Ident ident) {
+  auto & symbol = get_symbol(ident);
+  switch (symbol.kind) {
+  case Symbol::CONST: return TypedOperand{symbol.type, symbol.ir};
+  case Symbol::VAR:
+  {
+    auto vreg = get_block()->push_back(ir::Load{
+      symbol.type,
+      symbol.ir
+    });
+    return TypedOperand{symbol.type, vreg};
+  }
+  case Symbol::LOCAL: return TypedOperand{symbol.type, this->ssa.read(symbol.local, get_block())};
+  case Symbol::FUNC: throw "function used as a variable";
+  }
+}
+
 ir::Operand Codegen::cast(const TypedOperand && operand, ir::Type type) {
   if (operand.type != type) {
-    ir::InstrRef vreg;
+    ir::Operand vreg;
     if (operand.type == ir::I1 && type == ir::I32) {
-      vreg = get_block()->push_back(ir::Zext{ir::I1, operand.inner, ir::I32});
+      vreg = this->build.zext(*get_block(), ir::I1, operand.inner, ir::I32);
     } else if (operand.type == ir::I32 && type == ir::I1) {
-      vreg = get_block()->push_back(ir::Binary{
+      vreg = this->build.binary(
+        *get_block(),
         ir::Binary::ICMP_NE,
         ir::I32,
         operand.inner,
         ir::Const{0}
-      });
+      );
     } else {
       throw "unsupported cast";
     }
@@ -449,76 +957,100 @@ ir::Operand Codegen::cast(const TypedOperand && operand, ir::Type type) {
 }
 
 const Symbol & Codegen::get_symbol(const ast::Ident & ident) {
-  for (auto & scope : this->scopes | std::views::reverse) {
-    auto symbol = scope.find(ident);
-    if (symbol != scope.end()) return symbol->second;
-  }
-  if (ident == "getch") {
-    return this->scopes.front().insert({
-      "getch",
-      Symbol{Symbol::FUNC, ir::I32, 0, ir::Global{"getch"}}
-    }).first->second;
-  } else if (ident == "putch") {
-    return this->scopes.front().insert({
-      "putch",
-      Symbol{Symbol::FUNC, ir::VOID, 1, ir::Global{"putch"}}
-    }).first->second;
-  } else if (ident == "getint") {
-    return this->scopes.front().insert({
-      "getint",
-      Symbol{Symbol::FUNC, ir::I32, 0, ir::Global{"getint"}}
-    }).first->second;
-  } else if (ident == "putint") {
-    return this->scopes.front().insert({
-      "putint",
-      Symbol{Symbol::FUNC, ir::VOID, 1, ir::Global{"putint"}}
-    }).first->second;
-  }
-  throw "can't find symbol";
+  auto decl = this->symbols.find(ident);
+  if (decl == SymbolTable::none && this->globals != nullptr) {
+    // a worker declares only the builtins and its locals itself
+    auto global = this->globals->find(ident);
+    if (global < this->visible_globals) return (*this->globals)[global];
+  }
+  if (decl == SymbolTable::none) throw "can't find symbol";
+  if (decl < std::size(builtins) && (this->used_builtins & (1U << decl)) == 0) {
+    this->used_builtins |= 1U << decl;
+    this->new_globals.push_back(ident);
+  }
+  return this->symbols[decl];
+}
+
+// `lhs` and `rhs` evaluate the operands; && and || short-circuit, and the
+// rest is computed as the folded instruction would be
+template<typename Lhs, typename Rhs>
+static int eval_binary(ast::Binary::Op op, Lhs && lhs, Rhs && rhs) {
+  switch (op) {
+  case ast::Binary::AND: return int(lhs() && rhs());
+  case ast::Binary::OR: return int(lhs() || rhs());
+  default: break;
+  }
+  int lhs_value = lhs();
+  int rhs_value = rhs();
+  auto value = fold_binary(binary_op(op).op, lhs_value, rhs_value);
+  if (!value.has_value()) throw "division by zero or overflow in constant expression";
+  return *value;
+}
+
+static int eval_unary(ast::Unary::Op op, int operand) {
+  switch (op) {
+  case ast::Unary::POS: return operand;
+  case ast::Unary::NEG: return *fold_binary(ir::Binary::SUB, 0, operand); // wraps, as sub 0, x
+  case ast::Unary::NOT: return int(!operand);
+  }
+}
+
+int Codegen::get_const(ast::Ident ident) {
+  auto & symbol = get_symbol(ident);
+  switch (symbol.kind) {
+  case Symbol::CONST:
+    return symbol.ir.get<ir::Const>().value;
+  case Symbol::VAR:
+  case Symbol::LOCAL:
+    throw "constant must be initialized with a constant expression";
+  case Symbol::FUNC:
+    throw "function used as a variable";
+  }
 }
 
 int Codegen::eval_constexpr(const ast::Expr & expr) {
   return std::visit(overloaded {
     [this](const ast::Binary & expr) {
-      switch (expr.op) {
-      case ast::Binary::PLUS: return eval_constexpr(*expr.lhs) + eval_constexpr(*expr.rhs);
-      case ast::Binary::MINUS: return eval_constexpr(*expr.lhs) - eval_constexpr(*expr.rhs);
-      case ast::Binary::MULT: return eval_constexpr(*expr.lhs) * eval_constexpr(*expr.rhs);
-      case ast::Binary::DIV: return eval_constexpr(*expr.lhs) / eval_constexpr(*expr.rhs);
-      case ast::Binary::MOD: return eval_constexpr(*expr.lhs) % eval_constexpr(*expr.rhs);
-      case ast::Binary::LT: return int(eval_constexpr(*expr.lhs) < eval_constexpr(*expr.rhs));
-      case ast::Binary::LTEQ: return int(eval_constexpr(*expr.lhs) <= eval_constexpr(*expr.rhs));
-      case ast::Binary::GT: return int(eval_constexpr(*expr.lhs) > eval_constexpr(*expr.rhs));
-      case ast::Binary::GTEQ: return int(eval_constexpr(*expr.lhs) >= eval_constexpr(*expr.rhs));
-      case ast::Binary::EQ: return int(eval_constexpr(*expr.lhs) == eval_constexpr(*expr.rhs));
-      case ast::Binary::NEQ: return int(eval_constexpr(*expr.lhs) != eval_constexpr(*expr.rhs));
-      case ast::Binary::AND: return int(eval_constexpr(*expr.lhs) && eval_constexpr(*expr.rhs));
-      case ast::Binary::OR: return int(eval_constexpr(*expr.lhs) || eval_constexpr(*expr.rhs));
-      }
+      return eval_binary(
+        expr.op,
+        [&]() { return eval_constexpr(*expr.lhs); },
+        [&]() { return eval_constexpr(*expr.rhs); }
+      );
     },
     [this](const ast::Unary & expr) {
-      switch (expr.op) {
-      case ast::Unary::POS: return eval_constexpr(*expr.operand);
-      case ast::Unary::NEG: return -eval_constexpr(*expr.operand);
-      case ast::Unary::NOT: return int(!eval_constexpr(*expr.operand));
-      }
+      return eval_unary(expr.op, eval_constexpr(*expr.operand));
     },
     [](const ast::FuncCall & expr) -> int {
       throw "constant must be initialized with a constant expression";
     },
-    [this](const ast::Ident & ident) -> int {
-      auto & symbol = get_symbol(ident);
-      switch (symbol.kind) {
-      case Symbol::CONST:
-        return std::get<ir::Const>(symbol.ir).value;
-      case Symbol::VAR:
-        throw "constant must be initialized with a constant expression";
-      case Symbol::FUNC:
-        throw "function used as a variable";
-      }
+    [this](const ast::Ident & ident) {
+      return get_const(ident);
     },
     [](int number) {
       return number;
     },
   }, expr);
 }
+
+int Codegen::eval_constexpr(const ast::FlatProgram & program, std::uint32_t expr) {
+  using ast::FlatExprs;
+  auto & exprs = program.exprs;
+  switch (exprs.tags[expr]) {
+  case FlatExprs::NUMBER:
+    return int(exprs.values[expr]);
+  case FlatExprs::IDENT:
+    return get_const(Sym{exprs.values[expr]});
+  case FlatExprs::UNARY:
+    return eval_unary(ast::Unary::Op(exprs.ops[expr]), eval_constexpr(program, expr - 1));
+  case FlatExprs::BINARY:
+    return eval_binary(
+      ast::Binary::Op(exprs.ops[expr]),
+      [&]() { return eval_constexpr(program, exprs.lhs(expr)); },
+      [&]() { return eval_constexpr(program, expr - 1); }
+    );
+  case FlatExprs::CALLEE:
+  case FlatExprs::CALL:
+    break;
+  }
+  throw "constant must be initialized with a constant expression";
+}
@@ -1,24 +1,30 @@
-#include <map>
+#pragma once
 
 #include "ast.hpp"
+#include "flat_ast.hpp"
 #include "ir.hpp"
+#include "ir_builder.hpp"
+#include "ssa_builder.hpp"
+#include "symbol_table.hpp"
 
-struct Symbol {
-  enum Kind {
-    CONST, VAR, FUNC
-  } kind;
-  ir::Type type; // int or void
-  int argc; // currently only int args are supported
-  ir::Operand ir;
+struct CodegenOptions {
+  // fold constants and trivial identities while building the IR
+  bool fold = false;
+  // branch on the operands of &&, || and ! in conditions, so the right-hand
+  // side is only evaluated when the left-hand side doesn't decide
+  bool short_circuit = false;
+  // keep local variables in SSA form as the code is generated, instead of
+  // in memory with alloca, load and store
+  bool ssa = false;
 };
 
-using Scope = std::map<std::string, Symbol>;
-
 struct LoopContext {
   // begin of loop.
   ir::Label loop_begin;
   // blocks that need to be added a break
   std::vector<ir::Label> breaks;
+  // blocks that end with a continue
+  std::vector<ir::Label> continues;
 };
 
 struct TypedOperand {
@@ -26,28 +32,118 @@ struct TypedOperand {
   ir::Operand inner;
 };
 
+// a branch target that is set once its block exists
+struct Jump {
+  ir::Label from;
+  ir::Label * target;
+};
+
+struct CondJumps {
+  std::vector<Jump> if_true;
+  std::vector<Jump> if_false;
+};
+
+// the blocks of an if, if-else or while statement being generated
+struct BranchContext {
+  // where the condition branches to when it is false
+  std::vector<Jump> cond_false;
+  ir::Label before_loop;
+  ir::Label cond_begin;
+  ir::Label true_end;
+  ir::Label false_begin;
+};
+
 struct Codegen {
 private:
-  std::vector<Scope> scopes;
+  CodegenOptions options;
+  IrBuilder build;
+  // with options.ssa, for the function being generated
+  SsaBuilder ssa;
+  // the runtime library functions in the outermost scope, then the globals
+  SymbolTable symbols;
+  // bit i: builtins[i] was used, so it is declared in the output
+  unsigned used_builtins = 0;
   std::vector<LoopContext> loop_contexts;
   ir::Program ir;
+  // reused by add_expr for the flat AST
+  std::vector<TypedOperand> operands;
+  std::vector<const Symbol *> callees;
+  // names added to the global scope since the last take_globals
+  std::vector<Sym> new_globals;
+  // in a worker generating one function of a larger program: the globals
+  // declared up to that function, shared by all workers
+  const SymbolTable * globals = nullptr;
+  std::uint32_t visible_globals = 0;
+
+  Codegen(CodegenOptions options_, const SymbolTable & globals_, std::uint32_t visible_globals_);
 
 public:
-  Codegen();
+  explicit Codegen(CodegenOptions options_ = {});
 
   ir::Program get() &&;
-  void add_program(const ast::Program & program);
+  // with jobs > 1, the functions are generated on that many threads after
+  // a serial pass over the declarations; the result is the same
+  void add_program(const ast::Program & program, unsigned jobs = 1);
+  // generates the same code as for the tree the program was flattened from
+  void add_program(const ast::FlatProgram & program);
+  void add_global(const ast::Global & global);
+
+  // For generating a program one declaration at a time: the code since the
+  // last call, the global symbols it declared (builtins included), and
+  // declaring the symbols of declarations generated before.
+  ir::Program take_ir();
+  std::vector<std::pair<Sym, Symbol>> take_globals();
+  void add_globals(const std::vector<std::pair<Sym, Symbol>> & symbols);
 
 private:
   void add_func(const ast::Func & func);
   void add_var_decl(const ast::VarDecl & decl);
   void add_stmt(const ast::Stmt & stmt);
   TypedOperand add_expr(const ast::Expr & expr);
+
+  void add_var_decl(const ast::FlatProgram & program, std::uint32_t decl);
+  TypedOperand add_expr(const ast::FlatProgram & program, std::uint32_t root);
+  int eval_constexpr(const ast::FlatProgram & program, std::uint32_t expr);
+
+  // shared by both forms of the AST
+  void declare_func(ast::Type rettype, ast::Ident name, std::span<const ast::ArgDef> args);
+  void begin_func(ast::Type rettype, ast::Ident name, std::span<const ast::ArgDef> args);
+  void end_func();
+  void declare_const(ast::Ident name, int value);
+  void declare_global(ast::Ident name, int value);
+  Symbol declare_local(ast::Ident name);
+  void assign(const Symbol & var, ir::Operand value);
+  ir::Label new_block(std::vector<ir::Label> && preds);
+  CondJumps add_cond(const ast::Expr & cond);
+  CondJumps add_cond(const ast::FlatProgram & program, std::uint32_t root);
+  void begin_rhs(ast::Binary::Op op, CondJumps & lhs);
+  CondJumps add_branch(TypedOperand && cond);
+  BranchContext begin_if(CondJumps && cond);
+  void begin_else(BranchContext & context);
+  void end_if(BranchContext & context);
+  void end_if_else(BranchContext & context);
+  BranchContext begin_while();
+  void begin_while_body(BranchContext & context, CondJumps && cond);
+  void end_while(BranchContext & context);
+  const Symbol & get_assignee(ast::Ident var);
+  void check_return(bool has_value);
+  void add_return(TypedOperand && retval);
+  void add_return();
+  void add_break();
+  void add_continue();
+  TypedOperand add_unary(ast::Unary::Op op, TypedOperand && operand);
+  const Symbol & get_callee(ast::Ident func, std::size_t argc);
+  TypedOperand add_call(const Symbol & callee, std::vector<std::pair<ir::Type, ir::Use>> && args);
+  TypedOperand add_ident(ast::Ident ident);
+  int get_const(ast::Ident ident);
+
   ir::Operand cast(const TypedOperand && operand, ir::Type type);
 
-  inline Scope & get_scope() {
-    return this->scopes.back();
+  inline bool at_global_scope() const {
+    return this->symbols.depth() == 2;
   }
+  // declares `name` in the current scope; false if it is already there
+  bool declare(Sym name, Symbol && symbol);
   inline LoopContext & get_loop_context() {
     if (this->loop_contexts.empty()) throw "break or continue used outside loop";
     return this->loop_contexts.back();
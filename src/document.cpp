@@ -0,0 +1,206 @@
+#include <algorithm>
+#include <iterator>
+#include <ostream>
+
+#include "document.hpp"
+#include "parser.hpp"
+
+Document::Document(std::string text_) : text(std::move(text_)), lex_error(nullptr), truncated(false) {
+  rebuild();
+}
+
+void Document::rebuild() {
+  this->items.clear();
+  this->lex_error = nullptr;
+  this->truncated = false;
+  TokenArray tokens;
+  try {
+    tokens = lex_all(this->text.data(), this->text.data() + this->text.size()); // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+  } catch (const char * err) {
+    this->lex_error = err;
+    return;
+  }
+  // only the ERR at the end of input is empty
+  this->truncated = tokens.lengths.back() != 0;
+  this->items = parse_items(tokens, 0, true);
+}
+
+std::vector<Document::Item> Document::parse_items(const TokenArray & tokens, std::size_t base, bool at_end) {
+  auto starts = find_globals(tokens);
+  std::vector<Item> result;
+  for (std::size_t i = 0; i + 1 < starts.size(); i++) {
+    auto & item = result.emplace_back(Item{
+      base + tokens.offsets[starts[i]], {}, Item::PARSED, nullptr, {}, {}, false
+    });
+    TokenCursor cursor{tokens, starts[i]};
+    try {
+      item.ast.push_back(parse_global(cursor, item.ast.arena));
+      if (cursor.position() != starts[i + 1]) item.state = Item::UNSURE;
+    } catch (const char * err) {
+      // at the final ERR, the tokens after it might have continued the declaration
+      bool exact = at_end || cursor.position() + 1 < tokens.size();
+      item.state = exact ? Item::FAILED : Item::UNSURE;
+      item.error = err;
+    }
+  }
+  return result;
+}
+
+void Document::edit(std::size_t offset, std::size_t length, std::string_view replacement) {
+  if (offset > this->text.size() || length > this->text.size() - offset) {
+    throw "edit out of range";
+  }
+  this->text.replace(offset, length, replacement);
+  if (this->lex_error != nullptr || this->truncated || this->items.empty()) {
+    rebuild();
+    return;
+  }
+
+  // [first, last) are the items the edit touches; the token before an item
+  // is in the item before it
+  auto before = [](std::size_t pos, const Item & item) { return pos < item.begin; };
+  auto first = std::upper_bound(this->items.begin(), this->items.end(), offset, before);
+  if (first != this->items.begin()) first--;
+  if (first != this->items.begin() && first->begin == offset) first--;
+  auto last = std::upper_bound(first, this->items.end(), offset + length, before);
+
+  // re-lex until a token starts where an item after the edit starts
+  std::size_t from = first == this->items.begin() ? 0 : first->begin;
+  std::vector<std::size_t> stops;
+  stops.reserve(std::size_t(this->items.end() - last));
+  for (auto item = last; item != this->items.end(); item++) {
+    item->begin = item->begin + replacement.size() - length;
+    stops.push_back(item->begin - from);
+  }
+  TokenArray tokens;
+  try {
+    tokens = relex(this->text.data() + from, this->text.data() + this->text.size(), stops); // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+  } catch (const char *) {
+    rebuild();
+    return;
+  }
+  if (tokens.lengths.back() != 0) {
+    // a lexing error ends the program early
+    rebuild();
+    return;
+  }
+  auto end = std::lower_bound(
+    last, this->items.end(), from + tokens.offsets.back(),
+    [](const Item & item, std::size_t pos) { return item.begin < pos; }
+  );
+
+  auto fresh = parse_items(tokens, from, end == this->items.end());
+  if (fresh.size() == std::size_t(end - first)) {
+    // compared one to one when generated, to tell whether the items after
+    // need to be generated again
+    for (std::size_t i = 0; i < fresh.size(); i++) {
+      fresh[i].exports = std::move(first[std::ptrdiff_t(i)].exports);
+    }
+  } else {
+    for (auto item = end; item != this->items.end(); item++) {
+      item->generated = false;
+    }
+  }
+  auto at = this->items.erase(first, end);
+  this->items.insert(at, std::make_move_iterator(fresh.begin()), std::make_move_iterator(fresh.end()));
+}
+
+const char * Document::diagnose() {
+  if (this->lex_error != nullptr) return this->lex_error;
+  for (auto & item : this->items) {
+    if (item.state == Item::FAILED) return item.error;
+    if (item.state == Item::UNSURE) {
+      try {
+        compile_all();
+      } catch (const char * err) {
+        return err;
+      }
+      return nullptr;
+    }
+  }
+  return generate();
+}
+
+// Global symbols are equal if they declare the same thing:
+// their operand is either the name itself or a constant.
+static bool same_symbols(
+  const std::vector<std::pair<Sym, Symbol>> & lhs,
+  const std::vector<std::pair<Sym, Symbol>> & rhs
+) {
+  return std::ranges::equal(lhs, rhs, [](const auto & l, const auto & r) {
+    if (l.first != r.first) return false;
+    const Symbol & a = l.second;
+    const Symbol & b = r.second;
+    if (a.kind != b.kind || a.type != b.type || a.argc != b.argc) return false;
+    auto a_const = a.ir.get_if<ir::Const>();
+    auto b_const = b.ir.get_if<ir::Const>();
+    if (!a_const || !b_const) return a_const.has_value() == b_const.has_value();
+    return a_const->value == b_const->value;
+  });
+}
+
+const char * Document::generate() {
+  auto first = std::ranges::find(this->items, false, &Item::generated);
+  if (first == this->items.end()) return nullptr;
+  Codegen codegen;
+  for (auto item = this->items.begin(); item != first; item++) {
+    codegen.add_globals(item->exports);
+  }
+  // some symbols changed, so every later item is generated again
+  bool changed = false;
+  for (auto item = first; item != this->items.end(); item++) {
+    if (item->generated && !changed) {
+      codegen.add_globals(item->exports);
+      continue;
+    }
+    try {
+      codegen.add_global(item->ast.front());
+    } catch (const char * err) {
+      item->generated = false;
+      if (changed) {
+        // generated with symbols of the items before that are gone now
+        for (auto rest = item; rest != this->items.end(); rest++) {
+          rest->generated = false;
+        }
+      }
+      return err;
+    }
+    item->ir = codegen.take_ir();
+    foreach_func(item->ir, assign_vregs);
+    auto exports = codegen.take_globals();
+    changed = changed || !same_symbols(exports, item->exports);
+    item->exports = std::move(exports);
+    item->generated = true;
+  }
+  return nullptr;
+}
+
+ir::Program Document::compile_all() const {
+  auto tokens = lex_all(this->text.data(), this->text.data() + this->text.size()); // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+  auto ast = parse(tokens);
+  Codegen codegen;
+  codegen.add_program(ast);
+  auto program = std::move(codegen).get();
+  foreach_func(program, assign_vregs);
+  return program;
+}
+
+void Document::print(std::ostream & out) {
+  if (auto err = diagnose()) {
+    out << err << std::endl;
+    return;
+  }
+  if (std::ranges::any_of(this->items, [](const Item & item) { return item.state == Item::UNSURE; })) {
+    out << compile_all();
+    return;
+  }
+  // the builtin declarations come first
+  Codegen globals;
+  for (auto & item : this->items) {
+    globals.add_globals(item.exports);
+  }
+  out << std::move(globals).get();
+  for (auto & item : this->items) {
+    out << item.ir;
+  }
+}
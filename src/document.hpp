@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ast.hpp"
+#include "codegen.hpp"
+#include "ir.hpp"
+#include "lexer.hpp"
+
+// A source text kept compiled while it is edited, for editor integration.
+//
+// Each top-level declaration is an item with its own AST and IR. An edit
+// re-lexes from the first item it touches until the tokens line up with an
+// unchanged item again; only the items in between are parsed again, and only
+// those, plus the items after any whose global symbols changed, are
+// generated again. Diagnostics and IR are always what a.out would produce
+// for the current text.
+struct Document {
+private:
+  struct Item {
+    // offset of the first token
+    std::size_t begin;
+    // the declaration, if it parsed
+    ast::Program ast;
+    enum State {
+      PARSED,
+      // a full parse fails at `error`
+      FAILED,
+      // the declaration didn't end where brace matching expected, so
+      // only a full parse can tell what happens
+      UNSURE
+    } state;
+    const char * error;
+    ir::Program ir;
+    // the global symbols the declaration added, builtins included
+    std::vector<std::pair<Sym, Symbol>> exports;
+    // `ir` and `exports` are up to date with the items before
+    bool generated;
+  };
+
+  std::string text;
+  std::vector<Item> items;
+  // thrown by the lexer; there are no items then
+  const char * lex_error;
+  // lexing stopped at an error, where the program ends
+  bool truncated;
+
+public:
+  explicit Document(std::string text_);
+
+  // replaces `length` bytes at `offset` by `replacement`
+  void edit(std::size_t offset, std::size_t length, std::string_view replacement);
+  // the error a.out would report, or nullptr
+  const char * diagnose();
+  // prints what a.out would print
+  void print(std::ostream & out);
+
+private:
+  void rebuild();
+  // the declarations of `tokens`, which start at offset `base` of the text;
+  // `at_end` means the final ERR is the end of the program
+  static std::vector<Item> parse_items(const TokenArray & tokens, std::size_t base, bool at_end);
+  const char * generate();
+  ir::Program compile_all() const;
+};
@@ -37,5 +37,11 @@ int main() {
     }
     cout << endl;
   }
+  // the same sets, in an order that visits blocks before their preds
+  std::reverse(order.begin(), order.end());
+  if (dominator_sets(0, inv_cfg, order) != dom) {
+    cout << "Dom depends on the order" << endl;
+    return 1;
+  }
   return 0;
 }
@@ -0,0 +1,230 @@
+#include <ranges>
+
+#include "flat_ast.hpp"
+#include "overloaded.hpp"
+
+using namespace ast;
+
+namespace {
+
+struct Flattener {
+  FlatProgram & out;
+
+  // expression nodes whose operands haven't all been flattened yet
+  struct ExprWork {
+    const Expr * expr;
+    bool expanded;
+  };
+  std::vector<ExprWork> expr_work;
+  // roots of the finished operands
+  std::vector<std::uint32_t> operands;
+
+  // statements to flatten, or nodes to finish, in reverse order
+  struct StmtWork {
+    enum Kind {
+      STMT, // flatten `stmt`
+      END, // `node` ends here
+      ELSE // the false body of `node` starts here
+    } kind;
+    const Stmt * stmt;
+    std::uint32_t node;
+  };
+  std::vector<StmtWork> stmt_work;
+
+  std::uint32_t push_expr(FlatExprs::Tag tag, std::uint8_t op, std::uint32_t value, std::uint32_t size) {
+    auto & exprs = this->out.exprs;
+    auto index = std::uint32_t(exprs.size());
+    exprs.tags.push_back(tag);
+    exprs.ops.push_back(op);
+    exprs.values.push_back(value);
+    exprs.sizes.push_back(size);
+    exprs.parents.push_back(no_node);
+    return index;
+  }
+
+  // makes the top `count` operands children of a node pushed next;
+  // returns the size of their subtrees
+  std::uint32_t adopt_operands(std::size_t count) {
+    auto & exprs = this->out.exprs;
+    auto parent = std::uint32_t(exprs.size());
+    std::uint32_t size = 0;
+    for (std::size_t i = this->operands.size() - count; i < this->operands.size(); i++) {
+      exprs.parents[this->operands[i]] = parent;
+      size += exprs.sizes[this->operands[i]];
+    }
+    this->operands.resize(this->operands.size() - count);
+    return size;
+  }
+
+  std::uint32_t add_expr(const Expr & expr) {
+    this->expr_work.push_back(ExprWork{&expr, false});
+    while (!this->expr_work.empty()) {
+      auto work = this->expr_work.back();
+      this->expr_work.pop_back();
+      std::visit(overloaded {
+        [this, work](const Binary & expr) {
+          if (!work.expanded) {
+            this->expr_work.push_back(ExprWork{work.expr, true});
+            this->expr_work.push_back(ExprWork{expr.rhs, false});
+            this->expr_work.push_back(ExprWork{expr.lhs, false});
+            return;
+          }
+          auto size = adopt_operands(2);
+          this->operands.push_back(push_expr(FlatExprs::BINARY, expr.op, 0, size + 1));
+        },
+        [this, work](const Unary & expr) {
+          if (!work.expanded) {
+            this->expr_work.push_back(ExprWork{work.expr, true});
+            this->expr_work.push_back(ExprWork{expr.operand, false});
+            return;
+          }
+          auto size = adopt_operands(1);
+          this->operands.push_back(push_expr(FlatExprs::UNARY, expr.op, 0, size + 1));
+        },
+        [this, work](const FuncCall & expr) {
+          if (!work.expanded) {
+            this->operands.push_back(push_expr(FlatExprs::CALLEE, 0, expr.func.id, 1));
+            this->expr_work.push_back(ExprWork{work.expr, true});
+            for (auto & arg : expr.args | std::views::reverse) {
+              this->expr_work.push_back(ExprWork{&arg, false});
+            }
+            return;
+          }
+          auto size = adopt_operands(expr.args.size() + 1);
+          auto argc = std::uint32_t(expr.args.size());
+          this->operands.push_back(push_expr(FlatExprs::CALL, 0, argc, size + 1));
+        },
+        [this](const Ident & ident) {
+          this->operands.push_back(push_expr(FlatExprs::IDENT, 0, ident.id, 1));
+        },
+        [this](const Number & number) {
+          this->operands.push_back(push_expr(FlatExprs::NUMBER, 0, std::uint32_t(number), 1));
+        }
+      }, *work.expr);
+    }
+    auto root = this->operands.back();
+    this->operands.pop_back();
+    return root;
+  }
+
+  std::uint32_t push_stmt(FlatStmts::Tag tag, std::uint32_t expr = no_node, std::uint32_t value = 0) {
+    auto & stmts = this->out.stmts;
+    auto index = std::uint32_t(stmts.size());
+    stmts.tags.push_back(tag);
+    stmts.exprs.push_back(expr);
+    stmts.values.push_back(value);
+    stmts.ends.push_back(index + 1);
+    return index;
+  }
+
+  void add_var_decl(const VarDecl & decl) {
+    auto & decls = this->out.decls;
+    auto & defs = this->out.defs;
+    push_stmt(FlatStmts::VAR_DECL, no_node, std::uint32_t(decls.types.size()));
+    decls.is_const.push_back(decl.is_const);
+    decls.types.push_back(decl.type);
+    decls.first_defs.push_back(std::uint32_t(defs.names.size()));
+    decls.def_counts.push_back(std::uint32_t(decl.defs.size()));
+    for (auto & def : decl.defs) {
+      defs.names.push_back(def.name);
+      defs.inits.push_back(def.init.has_value() ? add_expr(def.init.value()) : no_node);
+    }
+  }
+
+  // flattens `body`, with the children of compound statements after them
+  void add_stmts(std::span<const Stmt> body) {
+    for (auto & stmt : body | std::views::reverse) {
+      this->stmt_work.push_back(StmtWork{StmtWork::STMT, &stmt, 0});
+    }
+    while (!this->stmt_work.empty()) {
+      auto work = this->stmt_work.back();
+      this->stmt_work.pop_back();
+      auto here = std::uint32_t(this->out.stmts.size());
+      if (work.kind == StmtWork::END) {
+        this->out.stmts.ends[work.node] = here;
+        continue;
+      }
+      if (work.kind == StmtWork::ELSE) {
+        this->out.stmts.values[work.node] = here;
+        continue;
+      }
+      std::visit(overloaded {
+        [this](std::monostate _) {
+          push_stmt(FlatStmts::EMPTY);
+        },
+        [this](const If & stmt) {
+          auto node = push_stmt(FlatStmts::IF, add_expr(stmt.cond));
+          this->stmt_work.push_back(StmtWork{StmtWork::END, nullptr, node});
+          this->stmt_work.push_back(StmtWork{StmtWork::STMT, stmt.true_body, 0});
+        },
+        [this](const IfElse & stmt) {
+          auto node = push_stmt(FlatStmts::IF_ELSE, add_expr(stmt.cond));
+          this->stmt_work.push_back(StmtWork{StmtWork::END, nullptr, node});
+          this->stmt_work.push_back(StmtWork{StmtWork::STMT, stmt.false_body, 0});
+          this->stmt_work.push_back(StmtWork{StmtWork::ELSE, nullptr, node});
+          this->stmt_work.push_back(StmtWork{StmtWork::STMT, stmt.true_body, 0});
+        },
+        [this](const While & stmt) {
+          auto node = push_stmt(FlatStmts::WHILE, add_expr(stmt.cond));
+          this->stmt_work.push_back(StmtWork{StmtWork::END, nullptr, node});
+          this->stmt_work.push_back(StmtWork{StmtWork::STMT, stmt.body, 0});
+        },
+        [this](const Block & block) {
+          auto node = push_stmt(FlatStmts::BLOCK);
+          this->stmt_work.push_back(StmtWork{StmtWork::END, nullptr, node});
+          for (auto & stmt : block | std::views::reverse) {
+            this->stmt_work.push_back(StmtWork{StmtWork::STMT, &stmt, 0});
+          }
+        },
+        [this](const Assign & stmt) {
+          push_stmt(FlatStmts::ASSIGN, add_expr(stmt.value), stmt.var.id);
+        },
+        [this](const Return & stmt) {
+          push_stmt(FlatStmts::RETURN, stmt.retval.has_value() ? add_expr(stmt.retval.value()) : no_node);
+        },
+        [this](const Break & _) {
+          push_stmt(FlatStmts::BREAK);
+        },
+        [this](const Continue & _) {
+          push_stmt(FlatStmts::CONTINUE);
+        },
+        [this](const Expr & expr) {
+          push_stmt(FlatStmts::EXPR, add_expr(expr));
+        },
+        [this](const VarDecl & decl) {
+          add_var_decl(decl);
+        }
+      }, *work.stmt);
+    }
+  }
+
+  void add_func(const Func & func) {
+    auto & funcs = this->out.funcs;
+    auto node = push_stmt(FlatStmts::FUNC, no_node, std::uint32_t(funcs.names.size()));
+    funcs.rettypes.push_back(func.rettype);
+    funcs.names.push_back(func.name);
+    funcs.first_args.push_back(std::uint32_t(this->out.args.size()));
+    funcs.arg_counts.push_back(std::uint32_t(func.args.size()));
+    this->out.args.insert(this->out.args.end(), func.args.begin(), func.args.end());
+    add_stmts(func.body);
+    this->out.stmts.ends[node] = std::uint32_t(this->out.stmts.size());
+  }
+};
+
+}
+
+FlatProgram ast::flatten(const Program & program) {
+  FlatProgram result;
+  Flattener flattener{result, {}, {}, {}};
+  for (auto & global : program) {
+    std::visit(overloaded {
+      [&flattener](const Func & func) {
+        flattener.add_func(func);
+      },
+      [&flattener](const VarDecl & decl) {
+        flattener.add_var_decl(decl);
+      }
+    }, global);
+  }
+  return result;
+}
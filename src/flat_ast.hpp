@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "ast.hpp"
+
+// The AST as flat, structure-of-arrays node storage: each kind of node
+// lives in its own set of parallel arrays, and nodes refer to each other
+// with 32-bit indices. Code generation walks each array front to back.
+
+namespace ast {
+
+// an absent node
+constexpr std::uint32_t no_node = std::numeric_limits<std::uint32_t>::max();
+
+// Expressions in post-order: every operand comes before its operator, and
+// the operator's rhs (or only operand) is the node right before it.
+// An expression is referred to by its root, which is its last node.
+struct FlatExprs {
+  enum Tag : std::uint8_t {
+    NUMBER, // value: the number
+    IDENT, // value: the Sym id
+    UNARY, // op: a Unary::Op
+    BINARY, // op: a Binary::Op
+    CALLEE, // value: the Sym id of the function; comes before the arguments
+    CALL // value: the argument count; comes after the arguments
+  };
+  std::vector<Tag> tags;
+  std::vector<std::uint8_t> ops;
+  std::vector<std::uint32_t> values;
+  // number of nodes in the subtree rooted here, so it starts at i + 1 - size
+  std::vector<std::uint32_t> sizes;
+  // the node this one is an operand of, or no_node for a root
+  std::vector<std::uint32_t> parents;
+
+  [[nodiscard]] inline std::size_t size() const {
+    return tags.size();
+  }
+  [[nodiscard]] inline std::uint32_t first(std::uint32_t root) const {
+    return root + 1 - sizes[root];
+  }
+  [[nodiscard]] inline std::uint32_t lhs(std::uint32_t binary) const {
+    return first(binary - 1) - 1;
+  }
+};
+
+// Statements and top-level declarations in pre-order: the children of a
+// node follow it, and `ends` is one past the last node of its subtree.
+struct FlatStmts {
+  enum Tag : std::uint8_t {
+    EMPTY,
+    IF, // expr: the condition; followed by the body
+    IF_ELSE, // expr: the condition; value: the first node of the false body
+    WHILE, // expr: the condition; followed by the body
+    BLOCK, // followed by its statements
+    ASSIGN, // value: the Sym id of the variable; expr: the new value
+    RETURN, // expr: the return value, or no_node
+    BREAK,
+    CONTINUE,
+    EXPR, // expr: the expression
+    VAR_DECL, // value: index into FlatDecls
+    FUNC // value: index into FlatFuncs; followed by the statements of the body
+  };
+  std::vector<Tag> tags;
+  std::vector<std::uint32_t> exprs;
+  std::vector<std::uint32_t> values;
+  std::vector<std::uint32_t> ends;
+
+  [[nodiscard]] inline std::size_t size() const {
+    return tags.size();
+  }
+};
+
+struct FlatDecls {
+  std::vector<std::uint8_t> is_const;
+  std::vector<Type> types;
+  // index into FlatDefs
+  std::vector<std::uint32_t> first_defs;
+  std::vector<std::uint32_t> def_counts;
+};
+
+struct FlatDefs {
+  std::vector<Ident> names;
+  // root of the initializer, or no_node
+  std::vector<std::uint32_t> inits;
+};
+
+struct FlatFuncs {
+  std::vector<Type> rettypes;
+  std::vector<Ident> names;
+  // index into FlatProgram::args
+  std::vector<std::uint32_t> first_args;
+  std::vector<std::uint32_t> arg_counts;
+};
+
+struct FlatProgram {
+  FlatExprs exprs;
+  FlatStmts stmts;
+  FlatDecls decls;
+  FlatDefs defs;
+  FlatFuncs funcs;
+  std::vector<ArgDef> args;
+};
+
+// builds the flat form of `program` without recursion
+FlatProgram flatten(const Program & program);
+
+}
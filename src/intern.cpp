@@ -0,0 +1,84 @@
+#include <array>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+
+#include "intern.hpp"
+
+namespace {
+
+// The table is split into shards by hash, each with its own lock,
+// so that lexer threads rarely wait on each other.
+// A symbol's id is (index within its shard) * shard_count + shard.
+constexpr std::uint32_t shard_count = 64;
+
+struct Shard {
+  std::shared_mutex mutex;
+  // deque keeps the strings in place, so the views into them stay valid
+  std::deque<std::string> texts;
+  std::unordered_map<std::string_view, std::uint32_t> ids;
+};
+
+using Interner = std::array<Shard, shard_count>;
+
+}
+
+// constructed on first use, so other static initializers may intern too
+static Interner & interner() {
+  static Interner instance;
+  return instance;
+}
+
+static Sym intern_locked(std::string_view text, std::size_t hash, std::string_view & stored_text) {
+  auto shard_idx = std::uint32_t(hash % shard_count);
+  auto & shard = interner()[shard_idx];
+  {
+    std::shared_lock lock{shard.mutex};
+    if (auto it = shard.ids.find(text); it != shard.ids.end()) {
+      stored_text = it->first;
+      return Sym{it->second};
+    }
+  }
+  std::unique_lock lock{shard.mutex};
+  // another thread may have added it in between
+  if (auto it = shard.ids.find(text); it != shard.ids.end()) {
+    stored_text = it->first;
+    return Sym{it->second};
+  }
+  auto id = std::uint32_t(shard.texts.size()) * shard_count + shard_idx;
+  stored_text = shard.texts.emplace_back(text);
+  shard.ids.emplace(stored_text, id);
+  return Sym{id};
+}
+
+Sym intern(std::string_view text) {
+  // Most identifiers repeat, so each thread remembers recent ones in a
+  // direct-mapped cache and only takes a shard lock on a miss.
+  struct CacheEntry {
+    std::string_view text;
+    Sym sym;
+  };
+  constexpr std::size_t cache_size = 4096;
+  thread_local std::array<CacheEntry, cache_size> cache{};
+
+  auto hash = std::hash<std::string_view>{}(text);
+  auto & entry = cache[(hash / shard_count) % cache_size];
+  if (entry.text == text && entry.text.data() != nullptr) {
+    return entry.sym;
+  }
+  entry.sym = intern_locked(text, hash, entry.text);
+  return entry.sym;
+}
+
+std::string_view text(Sym sym) {
+  auto & shard = interner()[sym.id % shard_count];
+  std::shared_lock lock{shard.mutex};
+  return shard.texts[sym.id / shard_count];
+}
+
+std::ostream & operator<<(std::ostream & out, Sym sym) {
+  return out << text(sym);
+}
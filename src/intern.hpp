@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string_view>
+
+// An interned identifier: equal names have equal ids,
+// so comparing and hashing them is integer work.
+struct Sym {
+  std::uint32_t id;
+
+  friend bool operator==(Sym lhs, Sym rhs) = default;
+  friend auto operator<=>(Sym lhs, Sym rhs) = default;
+};
+
+// the symbol for `text`, allocating a new id the first time it is seen
+Sym intern(std::string_view text);
+
+// the text `sym` was interned from
+std::string_view text(Sym sym);
+
+std::ostream & operator<<(std::ostream & out, Sym sym);
+
+template<>
+struct std::hash<Sym> {
+  inline std::size_t operator()(Sym sym) const noexcept {
+    return std::hash<std::uint32_t>{}(sym.id);
+  }
+};
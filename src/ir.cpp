@@ -1,9 +1,12 @@
+#include <algorithm>
+#include <map>
 #include <ostream>
+#include <vector>
 
 #include "ir.hpp"
 #include "overloaded.hpp"
 
-constexpr bool has_result(const ir::Instr & instr) {
+bool has_result(const ir::Instr & instr) {
   return std::visit(overloaded {
     [](const ir::Binary & instr) { return true; },
     [](const ir::Alloca & instr) { return true; },
@@ -27,6 +30,44 @@ void assign_vregs(ir::Func & func) {
   }
 }
 
+void replace_all_uses_with(ir::Instr & instr, const ir::Operand & value) {
+  // each assignment moves the first use to the list of `value`
+  while (auto use = instr.first_use()) {
+    *use = value;
+  }
+}
+
+bool erase_if_dead(ir::Block & block, ir::InstrRef instr) {
+  if (!instr->unused()) return false;
+  bool effect = std::holds_alternative<ir::Store>(*instr) || std::holds_alternative<ir::Call>(*instr);
+  if (effect) return false;
+  block.body.erase(instr);
+  return true;
+}
+
+bool phis_match_preds(ir::Func & func) {
+  std::map<ir::Label, std::vector<ir::Label>> preds;
+  for (auto & block : func.blocks) {
+    foreach_target(block.terminator, [&preds, &block](ir::Label & target) {
+      preds[target].push_back(&block);
+    });
+  }
+  std::vector<ir::Label> sources;
+  for (auto & block : func.blocks) {
+    auto & block_preds = preds[&block];
+    std::ranges::sort(block_preds);
+    for (auto & instr : block.body) {
+      auto phi = std::get_if<ir::Phi>(&instr);
+      if (phi == nullptr) continue;
+      sources.clear();
+      for (auto & source : phi->sources) sources.push_back(source.second);
+      std::ranges::sort(sources);
+      if (sources != block_preds) return false;
+    }
+  }
+  return true;
+}
+
 std::ostream & operator<<(std::ostream & out, const ir::Program & program) {
   for (auto & def : program) {
     out << def;
@@ -185,20 +226,12 @@ std::ostream & operator<<(std::ostream & out, const ir::Terminator & instr) {
 }
 
 std::ostream & operator<<(std::ostream & out, const ir::Operand & operand) {
-  std::visit(overloaded {
-    [&out](const ir::Const operand) {
-      out << operand.value;
-    },
-    [&out](const ir::Result operand) {
-      out << '%' << operand->vreg;
-    },
-    [&out](const ir::Arg operand) {
-      out << '%' << operand.idx;
-    },
-    [&out](const ir::Global & operand) {
-      out << '@' << operand;
-    },
-  }, operand);
+  switch (operand.kind()) {
+  case ir::Operand::CONST: out << operand.get<ir::Const>().value; break;
+  case ir::Operand::RESULT: out << '%' << operand.get<ir::Result>()->vreg; break;
+  case ir::Operand::ARG: out << '%' << operand.get<ir::Arg>().idx; break;
+  case ir::Operand::GLOBAL: out << '@' << operand.get<ir::Global>(); break;
+  }
   return out;
 }
 
@@ -1,10 +1,16 @@
 #pragma once
 
-#include <list>
-#include <string>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
 #include <variant>
 #include <vector>
 
+#include "intern.hpp"
+#include "overloaded.hpp"
+#include "slab.hpp"
+
 namespace ir {
 
 enum Type {
@@ -12,8 +18,11 @@ enum Type {
 };
 
 // Operand
-using BlockBody = std::list<struct Instr>;
-using FuncBody = std::list<struct Block>;
+struct Instr;
+struct Block;
+// the instructions and blocks of a function
+using FuncSlab = Slab<SlabNode<Instr>, SlabNode<Block>>;
+using BlockBody = SlabList<Instr, FuncSlab>;
 
 using InstrRef = BlockBody::iterator;
 using Label = Block*;
@@ -21,8 +30,133 @@ using Label = Block*;
 struct Const { int value; };
 using Result = InstrRef;
 struct Arg { int idx; };
-using Global = std::string;
-using Operand = std::variant<Const, Result, Arg, Global>;
+using Global = Sym;
+
+// One of Const, Result, Arg or Global in a single word, so the instructions
+// holding operands stay small. A result is kept as the address of its node,
+// whose low bits are free for the tag; the others keep their 32 bits in the
+// upper half. Two operands are equal if they are the same value.
+struct Operand {
+  enum Kind { RESULT, CONST, ARG, GLOBAL };
+
+  Operand() : Operand(Const{0}) {}
+  // NOLINTBEGIN(google-explicit-constructor)
+  Operand(Const value) : bits(pack(CONST, std::uint32_t(value.value))) {}
+  Operand(Result value) : bits(std::uint64_t(reinterpret_cast<std::uintptr_t>(value.link))) {}
+  Operand(Arg value) : bits(pack(ARG, std::uint32_t(value.idx))) {}
+  Operand(Global value) : bits(pack(GLOBAL, value.id)) {}
+  // NOLINTEND(google-explicit-constructor)
+
+  [[nodiscard]] inline Kind kind() const { return Kind(bits & TAG_MASK); }
+
+  template<typename T>
+  [[nodiscard]] inline bool is() const { return kind() == kind_of<T>(); }
+
+  // the value, which must be a T
+  template<typename T>
+  [[nodiscard]] inline T get() const {
+    if constexpr (std::is_same_v<T, Result>) {
+      return Result(reinterpret_cast<SlabLink *>(std::uintptr_t(bits)));
+    } else if constexpr (std::is_same_v<T, Global>) {
+      return Global{payload()};
+    } else {
+      return T{int(payload())};
+    }
+  }
+
+  template<typename T>
+  [[nodiscard]] inline std::optional<T> get_if() const {
+    if (!is<T>()) return std::nullopt;
+    return get<T>();
+  }
+
+  friend bool operator==(Operand lhs, Operand rhs) = default;
+
+private:
+  static constexpr std::uint64_t TAG_MASK = 3;
+  static_assert(alignof(SlabLink) > TAG_MASK);
+
+  std::uint64_t bits;
+
+  static constexpr std::uint64_t pack(Kind kind, std::uint32_t payload) {
+    return std::uint64_t(payload) << 32 | kind;
+  }
+  [[nodiscard]] inline std::uint32_t payload() const { return std::uint32_t(bits >> 32); }
+
+  template<typename T>
+  static constexpr Kind kind_of() {
+    if constexpr (std::is_same_v<T, Result>) return RESULT;
+    else if constexpr (std::is_same_v<T, Const>) return CONST;
+    else if constexpr (std::is_same_v<T, Arg>) return ARG;
+    else if constexpr (std::is_same_v<T, Global>) return GLOBAL;
+    else static_assert(!sizeof(T), "not an operand type");
+  }
+};
+static_assert(sizeof(Operand) == 8 && std::is_trivially_copyable_v<Operand>);
+
+// An operand held by an instruction or terminator. One that is the result
+// of an instruction is kept in that instruction's list of uses, so all the
+// uses of a result are found without a walk over the function. Change it
+// by assigning to the Use itself; an Operand copied out of it is a plain
+// value that uses nothing.
+struct Use : Operand {
+  Use() = default;
+  // NOLINTNEXTLINE(google-explicit-constructor)
+  Use(const Operand & value) : Operand(value) { link(); }
+  template<typename T>
+    requires (!std::is_base_of_v<Operand, std::remove_cvref_t<T>> && std::is_constructible_v<Operand, T>)
+  // NOLINTNEXTLINE(google-explicit-constructor)
+  Use(T && value) : Operand(std::forward<T>(value)) { link(); }
+  Use(const Use & other) : Operand(other) { link(); }
+  Use(Use && other) noexcept : Operand(other) { take_place(other); }
+  ~Use() { unlink(); }
+
+  Use & operator=(const Use & other) {
+    return *this = static_cast<const Operand &>(other);
+  }
+  Use & operator=(Use && other) noexcept {
+    if (this == &other) return *this;
+    unlink();
+    Operand::operator=(other);
+    take_place(other);
+    return *this;
+  }
+  inline Use & operator=(const Operand & value) {
+    unlink();
+    Operand::operator=(value);
+    link();
+    return *this;
+  }
+  template<typename T>
+    requires (!std::is_base_of_v<Operand, std::remove_cvref_t<T>> && std::is_constructible_v<Operand, T>)
+  Use & operator=(T && value) {
+    return *this = Operand(std::forward<T>(value));
+  }
+
+  // the next use of the same result
+  [[nodiscard]] inline Use * next_use() const { return next; }
+
+private:
+  friend struct Instr;
+
+  Use * next = nullptr;
+  // the pointer to this use, in the result or the previous use;
+  // null when not in a list
+  Use ** prev = nullptr;
+
+  inline void link();
+  inline void unlink();
+  // takes the place of `other` in its list, which saves relinking
+  inline void take_place(Use & other) {
+    this->next = other.next;
+    this->prev = other.prev;
+    other.next = nullptr;
+    other.prev = nullptr;
+    if (this->prev == nullptr) return;
+    *this->prev = this;
+    if (this->next != nullptr) this->next->prev = &this->next;
+  }
+};
 
 // instr
 
@@ -33,8 +167,8 @@ struct Binary {
     AND, OR,
   } op;
   Type type;
-  Operand lhs;
-  Operand rhs;
+  Use lhs;
+  Use rhs;
 };
 
 struct Alloca {
@@ -43,30 +177,30 @@ struct Alloca {
 
 struct Store {
   Type type;
-  Operand from;
-  Operand ptr;
+  Use from;
+  Use ptr;
 };
 
 struct Load {
   Type type;
-  Operand ptr;
+  Use ptr;
 };
 
 struct Call {
   Type type;
-  Operand func;
-  std::vector<std::pair<Type, Operand>> args;
+  Use func;
+  std::vector<std::pair<Type, Use>> args;
 };
 
 struct Zext {
   Type from_type;
-  Operand value;
+  Use value;
   Type to_type;
 };
 
 struct Phi {
   Type type;
-  std::vector<std::pair<Operand, Label>> sources;
+  std::vector<std::pair<Use, Label>> sources;
 };
 
 using Using_Instr = std::variant<
@@ -82,13 +216,63 @@ struct Instr : Using_Instr {
   int vreg;
 
   using Using_Instr::Using_Instr;
+  // a copy, or a moved instruction, starts with no uses: they refer to
+  // where the original is
+  Instr(const Instr & other) : Using_Instr(other), vreg(other.vreg) {}
+  Instr(Instr && other) noexcept : Using_Instr(std::move(other)), vreg(other.vreg) {}
+  // keeps the uses of the result
+  Instr & operator=(const Instr & other) {
+    Using_Instr::operator=(other);
+    this->vreg = other.vreg;
+    return *this;
+  }
+  Instr & operator=(Instr && other) noexcept {
+    Using_Instr::operator=(std::move(other));
+    this->vreg = other.vreg;
+    return *this;
+  }
+  // uses left over, e.g. when the whole function goes, are only detached
+  ~Instr() {
+    while (this->uses != nullptr) {
+      auto use = this->uses;
+      this->uses = use->next;
+      use->next = nullptr;
+      use->prev = nullptr;
+    }
+  }
+
+  [[nodiscard]] inline Use * first_use() const { return this->uses; }
+  [[nodiscard]] inline bool unused() const { return this->uses == nullptr; }
+
+private:
+  friend struct Use;
+
+  Use * uses = nullptr;
 };
 
+inline void Use::link() {
+  auto result = get_if<Result>();
+  if (!result) return;
+  auto & uses = (*result)->uses;
+  this->next = uses;
+  if (uses != nullptr) uses->prev = &this->next;
+  this->prev = &uses;
+  uses = this;
+}
+
+inline void Use::unlink() {
+  if (this->prev == nullptr) return;
+  *this->prev = this->next;
+  if (this->next != nullptr) this->next->prev = this->prev;
+  this->next = nullptr;
+  this->prev = nullptr;
+}
+
 // terminator
 
 struct Ret {
   Type type;
-  Operand retval;
+  Use retval;
 };
 
 struct Br {
@@ -96,7 +280,7 @@ struct Br {
 };
 
 struct BrCond {
-  Operand cond;
+  Use cond;
   Label iftrue;
   Label iffalse;
 };
@@ -109,7 +293,9 @@ using Terminator = std::variant<std::monostate, Ret, Br, BrCond>;
 struct Block {
   BlockBody body;
   Terminator terminator;
-  int label;
+  int label = 0;
+
+  explicit Block(FuncSlab & slab) : body(slab) {}
 
   [[nodiscard]] inline bool terminated() const {
     return terminator.index() != 0;
@@ -120,29 +306,66 @@ struct Block {
   }
 
   inline InstrRef push_back(Instr && instr) {
-    return body.insert(body.end(), instr);
+    return body.insert(body.end(), std::move(instr));
   }
+
+  inline InstrRef push_front(Instr && instr) {
+    return body.insert(body.begin(), std::move(instr));
+  }
+};
+
+// The blocks of a function. They and their instructions are kept in a slab
+// owned by the function, so they are released together with it.
+struct FuncBody {
+private:
+  using Blocks = SlabList<Block, FuncSlab>;
+  struct Storage {
+    FuncSlab slab;
+    // declared last, so the blocks are destroyed before the slab
+    Blocks list{slab};
+  };
+  std::unique_ptr<Storage> storage = std::make_unique<Storage>();
+
+public:
+  using iterator = Blocks::iterator;
+  using const_iterator = Blocks::const_iterator;
+
+  iterator begin() { return storage->list.begin(); }
+  iterator end() { return storage->list.end(); }
+  [[nodiscard]] const_iterator begin() const { return storage->list.begin(); }
+  [[nodiscard]] const_iterator end() const { return storage->list.end(); }
+  [[nodiscard]] bool empty() const { return storage->list.empty(); }
+  Block & front() { return storage->list.front(); }
+  Block & back() { return storage->list.back(); }
+
+  Label emplace_back() { return &storage->list.emplace_back(storage->slab); }
+  void pop_back() { storage->list.pop_back(); }
+  template<typename Pred>
+  std::size_t remove_if(Pred pred) { return storage->list.remove_if(pred); }
+
+  // for lists of instructions that may be spliced to and from the blocks
+  FuncSlab & slab() { return storage->slab; }
 };
 
 struct Func {
   Type rettype;
-  std::string name;
+  Sym name;
   std::vector<Type> args;
   FuncBody blocks;
 
   inline Label new_block() {
-    return &*blocks.insert(blocks.end(), Block{});
+    return blocks.emplace_back();
   }
 };
 
 struct FuncDecl {
   Type rettype;
-  std::string name;
+  Sym name;
   std::vector<Type> args;
 };
 
 struct GlobalVar {
-  std::string name;
+  Sym name;
   Type type;
   int value;
 };
@@ -162,8 +385,57 @@ void foreach_func(ir::Program & program, F f) {
   }
 }
 
+// calls `f` on each operand of `instr`, as an ir::Use
+template<typename F>
+void foreach_operand(ir::Instr & instr, F f) {
+  std::visit(overloaded {
+    [&f](ir::Binary & instr) { f(instr.lhs); f(instr.rhs); },
+    [](ir::Alloca & instr) {},
+    [&f](ir::Store & instr) { f(instr.from); f(instr.ptr); },
+    [&f](ir::Load & instr) { f(instr.ptr); },
+    [&f](ir::Call & instr) {
+      f(instr.func);
+      for (auto & arg : instr.args) f(arg.second);
+    },
+    [&f](ir::Zext & instr) { f(instr.value); },
+    [&f](ir::Phi & instr) {
+      for (auto & source : instr.sources) f(source.first);
+    },
+  }, instr);
+}
+
+template<typename F>
+void foreach_operand(ir::Terminator & terminator, F f) {
+  std::visit(overloaded {
+    [&f](ir::Ret & instr) { if (instr.type != ir::VOID) f(instr.retval); },
+    [&f](ir::BrCond & instr) { f(instr.cond); },
+    [](auto & _) {},
+  }, terminator);
+}
+
+// calls `f` on each block `terminator` may branch to, once per edge
+template<typename F>
+void foreach_target(ir::Terminator & terminator, F f) {
+  std::visit(overloaded {
+    [&f](ir::Br & instr) { f(instr.dest); },
+    [&f](ir::BrCond & instr) { f(instr.iftrue); f(instr.iffalse); },
+    [](auto & _) {},
+  }, terminator);
+}
+
+// whether `instr` gives a value, which assign_vregs numbers
+bool has_result(const ir::Instr & instr);
 void assign_vregs(ir::Func & func);
 
+// makes each use of the result of `instr` use `value` instead, which must
+// not be that result; takes time in the number of uses
+void replace_all_uses_with(ir::Instr & instr, const ir::Operand & value);
+// erases `instr` from `block` if nothing uses its result and it has no other
+// effect; returns whether it did
+bool erase_if_dead(ir::Block & block, ir::InstrRef instr);
+// whether each phi in `func` has one source for each edge into its block
+bool phis_match_preds(ir::Func & func);
+
 std::ostream & operator<<(std::ostream & out, const ir::Type & type);
 std::ostream & operator<<(std::ostream & out, const ir::Operand & operand);
 std::ostream & operator<<(std::ostream & out, const ir::Label & label);
@@ -0,0 +1,86 @@
+#include <cstdint>
+#include <limits>
+#include <optional>
+
+#include "ir_builder.hpp"
+
+std::optional<int> fold_binary(ir::Binary::Op op, int lhs, int rhs) {
+  auto wrap = [](std::uint32_t value) { return int(value); };
+  switch (op) {
+  case ir::Binary::ADD: return wrap(std::uint32_t(lhs) + std::uint32_t(rhs));
+  case ir::Binary::SUB: return wrap(std::uint32_t(lhs) - std::uint32_t(rhs));
+  case ir::Binary::MUL: return wrap(std::uint32_t(lhs) * std::uint32_t(rhs));
+  case ir::Binary::SDIV:
+  case ir::Binary::SREM:
+    if (rhs == 0 || (lhs == std::numeric_limits<int>::min() && rhs == -1)) return {};
+    return op == ir::Binary::SDIV ? lhs / rhs : lhs % rhs;
+  case ir::Binary::ICMP_SLT: return int(lhs < rhs);
+  case ir::Binary::ICMP_SLE: return int(lhs <= rhs);
+  case ir::Binary::ICMP_SGT: return int(lhs > rhs);
+  case ir::Binary::ICMP_SGE: return int(lhs >= rhs);
+  case ir::Binary::ICMP_EQ: return int(lhs == rhs);
+  case ir::Binary::ICMP_NE: return int(lhs != rhs);
+  case ir::Binary::AND: return lhs & rhs;
+  case ir::Binary::OR: return lhs | rhs;
+  }
+  return {};
+}
+
+// x op c for a constant c, when that is x or a constant
+static std::optional<ir::Operand> fold_identity(ir::Binary::Op op, ir::Operand x, int c) {
+  switch (op) {
+  case ir::Binary::ADD:
+  case ir::Binary::SUB:
+    if (c == 0) return x;
+    break;
+  case ir::Binary::MUL:
+    if (c == 1) return x;
+    if (c == 0) return ir::Const{0};
+    break;
+  case ir::Binary::SDIV:
+    if (c == 1) return x;
+    break;
+  case ir::Binary::SREM:
+    if (c == 1) return ir::Const{0};
+    break;
+  case ir::Binary::AND:
+    return c != 0 ? x : ir::Const{0};
+  case ir::Binary::OR:
+    return c != 0 ? ir::Operand{ir::Const{1}} : x;
+  default:
+    break;
+  }
+  return {};
+}
+
+static bool commutes(ir::Binary::Op op) {
+  return op == ir::Binary::ADD || op == ir::Binary::MUL || op == ir::Binary::AND || op == ir::Binary::OR;
+}
+
+ir::Operand IrBuilder::binary(ir::Block & block, ir::Binary::Op op, ir::Type type, ir::Operand lhs, ir::Operand rhs) const {
+  if (this->fold) {
+    auto lhs_const = lhs.get_if<ir::Const>();
+    auto rhs_const = rhs.get_if<ir::Const>();
+    if (lhs_const && rhs_const) {
+      if (auto value = fold_binary(op, lhs_const->value, rhs_const->value)) return ir::Const{*value};
+    } else if (rhs_const) {
+      if (auto result = fold_identity(op, lhs, rhs_const->value)) return *result;
+    } else if (lhs_const && commutes(op)) {
+      if (auto result = fold_identity(op, rhs, lhs_const->value)) return *result;
+    }
+  }
+  return block.push_back(ir::Binary{op, type, lhs, rhs});
+}
+
+ir::Operand IrBuilder::zext(ir::Block & block, ir::Type from_type, ir::Operand value, ir::Type to_type) const {
+  // an i1 constant is already 0 or 1
+  if (this->fold && value.is<ir::Const>()) return value;
+  return block.push_back(ir::Zext{from_type, value, to_type});
+}
+
+ir::Terminator IrBuilder::br_cond(ir::Operand cond, ir::Label iftrue, ir::Label iffalse) const {
+  if (auto cond_const = cond.get_if<ir::Const>(); this->fold && cond_const) {
+    return ir::Br{cond_const->value != 0 ? iftrue : iffalse};
+  }
+  return ir::BrCond{cond, iftrue, iffalse};
+}
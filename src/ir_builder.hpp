@@ -0,0 +1,22 @@
+#pragma once
+
+#include <optional>
+
+#include "ir.hpp"
+
+// the value of `op` on constants, like the instruction computes it at run
+// time: arithmetic wraps, and there is none for a division that traps,
+// x / 0 and INT_MIN / -1
+std::optional<int> fold_binary(ir::Binary::Op op, int lhs, int rhs);
+
+// Creates instructions at the end of a block. With `fold`, operations on
+// constants become constants, trivial identities like x + 0 and x * 1
+// return an operand, and branches on a constant become unconditional, so
+// no instruction is created for them.
+struct IrBuilder {
+  bool fold = false;
+
+  [[nodiscard]] ir::Operand binary(ir::Block & block, ir::Binary::Op op, ir::Type type, ir::Operand lhs, ir::Operand rhs) const;
+  [[nodiscard]] ir::Operand zext(ir::Block & block, ir::Type from_type, ir::Operand value, ir::Type to_type) const;
+  [[nodiscard]] ir::Terminator br_cond(ir::Operand cond, ir::Label iftrue, ir::Label iffalse) const;
+};
@@ -0,0 +1,570 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "ir_file.hpp"
+#include "overloaded.hpp"
+
+namespace {
+
+constexpr std::array<char, 8> magic{'S', 'Y', 'S', 'Y', '-', 'I', 'R', '\n'};
+// changed with the layout; a file from a machine of the other byte order
+// shows a different version as well
+constexpr std::uint32_t version = 1;
+
+// The arrays follow the header in this order, each padded to 8 bytes.
+struct Header {
+  std::array<char, 8> magic;
+  std::uint32_t version;
+  // the end of each symbol's name in `names`
+  std::uint32_t symbols;
+  // the names of the symbols, one after the other
+  std::uint32_t names;
+  std::uint32_t defs;
+  // the argument types of functions, a byte each
+  std::uint32_t arg_types;
+  std::uint32_t blocks;
+  std::uint32_t instrs;
+  // the operands, 8 bytes each
+  std::uint32_t words;
+};
+
+// stored instead of variant indices, so the file doesn't change with the
+// order of the alternatives
+enum DefKind : std::uint8_t { FUNC, FUNC_DECL, GLOBAL_VAR };
+enum TermKind : std::uint8_t { NO_TERM, RET, BR, BR_COND };
+enum InstrKind : std::uint8_t { ALLOCA, STORE, LOAD, BINARY, CALL, ZEXT, PHI };
+
+struct DefRecord {
+  DefKind kind;
+  // the return type, or the variable's type
+  std::uint8_t type;
+  std::uint16_t unused = 0;
+  std::uint32_t name;
+  // a variable's initial value
+  std::int32_t value;
+  std::uint32_t first_arg;
+  std::uint32_t argc;
+  std::uint32_t first_block;
+  std::uint32_t block_count;
+};
+
+struct BlockRecord {
+  // the operand of a ret or a conditional br
+  std::uint64_t value;
+  std::uint32_t first_instr;
+  std::uint32_t instr_count;
+  std::array<std::uint32_t, 2> targets;
+  TermKind terminator;
+  // of a ret
+  std::uint8_t type;
+  std::uint16_t unused = 0;
+  std::uint32_t unused2 = 0;
+};
+
+struct InstrRecord {
+  InstrKind kind;
+  // of a binary
+  std::uint8_t op;
+  // the type of the instruction, or the type a zext extends from
+  std::uint8_t type;
+  // the type a zext extends to
+  std::uint8_t to_type;
+  std::uint32_t first_word;
+  std::uint32_t word_count;
+};
+
+static_assert(sizeof(Header) % 8 == 0 && sizeof(BlockRecord) % 8 == 0);
+static_assert(std::is_trivially_copyable_v<DefRecord> && std::is_trivially_copyable_v<BlockRecord>
+  && std::is_trivially_copyable_v<InstrRecord>);
+
+// An operand: its ir::Operand::Kind in the low byte, the type of a call
+// argument in the next one, and its 32 bits in the upper half. These are a
+// constant, an argument's index, a symbol's index, or the index of an
+// instruction within its function. A phi's source is followed by a word
+// with the index of its block within the function in the upper half.
+constexpr std::uint64_t word(ir::Operand::Kind kind, std::uint32_t payload, ir::Type type = ir::VOID) {
+  return std::uint64_t(payload) << 32 | std::uint64_t(type) << 8 | kind;
+}
+
+struct Writer {
+  Header header{magic, version};
+  std::vector<std::uint32_t> symbol_ends;
+  std::string names;
+  std::unordered_map<Sym, std::uint32_t> symbols;
+  std::vector<DefRecord> defs;
+  std::vector<std::uint8_t> arg_types;
+  std::vector<BlockRecord> blocks;
+  std::vector<InstrRecord> instrs;
+  std::vector<std::uint64_t> words;
+  // the index of each instruction and block within the current function
+  std::unordered_map<const ir::Instr *, std::uint32_t> instr_index;
+  std::unordered_map<const ir::Block *, std::uint32_t> block_index;
+
+  std::uint32_t symbol(Sym sym);
+  std::uint64_t operand(const ir::Operand & operand, ir::Type type = ir::VOID);
+  DefRecord def(DefKind kind, ir::Type type, Sym name, const std::vector<ir::Type> & args);
+  void add(const ir::GlobalDef & def);
+  void add_func(const ir::Func & func);
+  void add_block(const ir::Block & block);
+  void add_instr(const ir::Instr & instr);
+  void write(std::ostream & out);
+};
+
+std::uint32_t Writer::symbol(Sym sym) {
+  auto [it, inserted] = this->symbols.try_emplace(sym, std::uint32_t(this->symbols.size()));
+  if (inserted) {
+    this->names += text(sym);
+    this->symbol_ends.push_back(std::uint32_t(this->names.size()));
+  }
+  return it->second;
+}
+
+std::uint64_t Writer::operand(const ir::Operand & operand, ir::Type type) {
+  std::uint32_t payload = 0;
+  switch (operand.kind()) {
+  case ir::Operand::RESULT: payload = this->instr_index.at(&*operand.get<ir::Result>()); break;
+  case ir::Operand::CONST: payload = std::uint32_t(operand.get<ir::Const>().value); break;
+  case ir::Operand::ARG: payload = std::uint32_t(operand.get<ir::Arg>().idx); break;
+  case ir::Operand::GLOBAL: payload = symbol(operand.get<ir::Global>()); break;
+  }
+  return word(operand.kind(), payload, type);
+}
+
+DefRecord Writer::def(DefKind kind, ir::Type type, Sym name, const std::vector<ir::Type> & args) {
+  DefRecord record{kind, std::uint8_t(type)};
+  record.name = symbol(name);
+  record.first_arg = std::uint32_t(this->arg_types.size());
+  record.argc = std::uint32_t(args.size());
+  this->arg_types.insert(this->arg_types.end(), args.begin(), args.end());
+  return record;
+}
+
+void Writer::add(const ir::GlobalDef & def) {
+  std::visit(overloaded {
+    [this](const ir::Func & func) { add_func(func); },
+    [this](const ir::FuncDecl & decl) {
+      this->defs.push_back(this->def(FUNC_DECL, decl.rettype, decl.name, decl.args));
+    },
+    [this](const ir::GlobalVar & var) {
+      this->defs.push_back(this->def(GLOBAL_VAR, var.type, var.name, {}));
+      this->defs.back().value = var.value;
+    },
+  }, def);
+}
+
+void Writer::add_func(const ir::Func & func) {
+  this->instr_index.clear();
+  this->block_index.clear();
+  std::uint32_t block_count = 0;
+  std::uint32_t instr_count = 0;
+  for (auto & block : func.blocks) {
+    this->block_index.emplace(&block, block_count++);
+    for (auto & instr : block.body) {
+      this->instr_index.emplace(&instr, instr_count++);
+    }
+  }
+
+  auto record = def(FUNC, func.rettype, func.name, func.args);
+  record.first_block = std::uint32_t(this->blocks.size());
+  record.block_count = block_count;
+  this->defs.push_back(record);
+  for (auto & block : func.blocks) {
+    add_block(block);
+  }
+}
+
+void Writer::add_block(const ir::Block & block) {
+  BlockRecord record{};
+  record.first_instr = std::uint32_t(this->instrs.size());
+  for (auto & instr : block.body) {
+    add_instr(instr);
+  }
+  record.instr_count = std::uint32_t(this->instrs.size()) - record.first_instr;
+
+  std::visit(overloaded {
+    [&record](const std::monostate & _) { record.terminator = NO_TERM; },
+    [this, &record](const ir::Ret & term) {
+      record.terminator = RET;
+      record.type = std::uint8_t(term.type);
+      record.value = operand(term.retval);
+    },
+    [this, &record](const ir::Br & term) {
+      record.terminator = BR;
+      record.targets[0] = this->block_index.at(term.dest);
+    },
+    [this, &record](const ir::BrCond & term) {
+      record.terminator = BR_COND;
+      record.value = operand(term.cond);
+      record.targets = {this->block_index.at(term.iftrue), this->block_index.at(term.iffalse)};
+    },
+  }, block.terminator);
+  this->blocks.push_back(record);
+}
+
+void Writer::add_instr(const ir::Instr & instr) {
+  InstrRecord record{};
+  record.first_word = std::uint32_t(this->words.size());
+  auto & words = this->words;
+  std::visit(overloaded {
+    [&record](const ir::Alloca & instr) {
+      record.kind = ALLOCA;
+      record.type = instr.type;
+    },
+    [this, &record, &words](const ir::Store & instr) {
+      record.kind = STORE;
+      record.type = instr.type;
+      words.push_back(operand(instr.from));
+      words.push_back(operand(instr.ptr));
+    },
+    [this, &record, &words](const ir::Load & instr) {
+      record.kind = LOAD;
+      record.type = instr.type;
+      words.push_back(operand(instr.ptr));
+    },
+    [this, &record, &words](const ir::Binary & instr) {
+      record.kind = BINARY;
+      record.op = instr.op;
+      record.type = instr.type;
+      words.push_back(operand(instr.lhs));
+      words.push_back(operand(instr.rhs));
+    },
+    [this, &record, &words](const ir::Call & instr) {
+      record.kind = CALL;
+      record.type = instr.type;
+      words.push_back(operand(instr.func));
+      for (auto & [type, arg] : instr.args) {
+        words.push_back(operand(arg, type));
+      }
+    },
+    [this, &record, &words](const ir::Zext & instr) {
+      record.kind = ZEXT;
+      record.type = instr.from_type;
+      record.to_type = instr.to_type;
+      words.push_back(operand(instr.value));
+    },
+    [this, &record, &words](const ir::Phi & instr) {
+      record.kind = PHI;
+      record.type = instr.type;
+      for (auto & [value, block] : instr.sources) {
+        words.push_back(operand(value));
+        words.push_back(word(ir::Operand::RESULT, this->block_index.at(block)));
+      }
+    },
+  }, instr);
+  record.word_count = std::uint32_t(words.size()) - record.first_word;
+  this->instrs.push_back(record);
+}
+
+template<typename T>
+void write_array(std::ostream & out, const T * data, std::size_t count) {
+  static constexpr std::array<char, 8> zeros{};
+  auto size = sizeof(T) * count;
+  out.write(reinterpret_cast<const char *>(data), std::streamsize(size)); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+  out.write(zeros.data(), std::streamsize((zeros.size() - size % zeros.size()) % zeros.size()));
+}
+
+void Writer::write(std::ostream & out) {
+  this->header.symbols = std::uint32_t(this->symbol_ends.size());
+  this->header.names = std::uint32_t(this->names.size());
+  this->header.defs = std::uint32_t(this->defs.size());
+  this->header.arg_types = std::uint32_t(this->arg_types.size());
+  this->header.blocks = std::uint32_t(this->blocks.size());
+  this->header.instrs = std::uint32_t(this->instrs.size());
+  this->header.words = std::uint32_t(this->words.size());
+  write_array(out, &this->header, 1);
+  write_array(out, this->symbol_ends.data(), this->symbol_ends.size());
+  write_array(out, this->names.data(), this->names.size());
+  write_array(out, this->defs.data(), this->defs.size());
+  write_array(out, this->arg_types.data(), this->arg_types.size());
+  write_array(out, this->blocks.data(), this->blocks.size());
+  write_array(out, this->instrs.data(), this->instrs.size());
+  write_array(out, this->words.data(), this->words.size());
+}
+
+void check(bool ok) {
+  if (!ok) throw "corrupt IR file";
+}
+
+// the records of one array, used in place
+template<typename T>
+std::span<const T> take(const char * & pos, const char * end, std::uint32_t count) {
+  auto size = sizeof(T) * count;
+  auto padded = (size + 7) / 8 * 8;
+  if (std::size_t(end - pos) < padded) throw "truncated IR file";
+  std::span<const T> records{reinterpret_cast<const T *>(pos), count}; // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+  pos += padded; // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+  return records;
+}
+
+// a range of `count` records from `first`, which must be in `records`
+template<typename T>
+std::span<const T> slice(std::span<const T> records, std::uint32_t first, std::uint32_t count) {
+  check(first <= records.size() && count <= records.size() - first);
+  return records.subspan(first, count);
+}
+
+struct Reader {
+  std::span<const std::uint32_t> symbol_ends;
+  std::span<const char> names;
+  std::span<const DefRecord> defs;
+  std::span<const std::uint8_t> arg_types;
+  std::span<const BlockRecord> blocks;
+  std::span<const InstrRecord> instrs;
+  std::span<const std::uint64_t> words;
+  std::vector<Sym> symbols;
+  // the blocks and instructions of the current function, by index
+  std::vector<ir::Label> labels;
+  std::vector<ir::InstrRef> results;
+  std::uint32_t first_instr = 0;
+  // instructions with operands that refer to later instructions, which
+  // are set once all are there
+  std::vector<std::pair<ir::InstrRef, const InstrRecord *>> pending;
+
+  Reader(const char * begin, const char * end);
+
+  ir::Program read();
+  void read_func(ir::Func & func, const DefRecord & def);
+  void read_block(ir::Label block, const BlockRecord & record);
+  ir::Instr read_instr(const InstrRecord & record, bool & forward);
+  ir::Terminator read_terminator(const BlockRecord & record);
+  ir::Operand read_operand(std::uint64_t word, bool & forward);
+  ir::Label read_label(std::uint32_t index);
+  ir::Label read_target(std::uint32_t index);
+  std::vector<ir::Type> read_args(const DefRecord & def);
+  static ir::Type read_type(std::uint8_t type);
+};
+
+Reader::Reader(const char * begin, const char * end) {
+  Header header{};
+  std::memcpy(&header, begin, sizeof(Header));
+  if (header.version != version) throw "unsupported IR file version";
+  const char * pos = begin;
+  take<Header>(pos, end, 1);
+  this->symbol_ends = take<std::uint32_t>(pos, end, header.symbols);
+  this->names = take<char>(pos, end, header.names);
+  this->defs = take<DefRecord>(pos, end, header.defs);
+  this->arg_types = take<std::uint8_t>(pos, end, header.arg_types);
+  this->blocks = take<BlockRecord>(pos, end, header.blocks);
+  this->instrs = take<InstrRecord>(pos, end, header.instrs);
+  this->words = take<std::uint64_t>(pos, end, header.words);
+}
+
+ir::Type Reader::read_type(std::uint8_t type) {
+  check(type <= ir::LABEL);
+  return ir::Type(type);
+}
+
+ir::Label Reader::read_label(std::uint32_t index) {
+  check(index < this->labels.size());
+  return this->labels[index];
+}
+
+// nothing branches to the entry block
+ir::Label Reader::read_target(std::uint32_t index) {
+  check(index != 0);
+  return read_label(index);
+}
+
+std::vector<ir::Type> Reader::read_args(const DefRecord & def) {
+  std::vector<ir::Type> args;
+  for (auto type : slice(this->arg_types, def.first_arg, def.argc)) {
+    args.push_back(read_type(type));
+  }
+  return args;
+}
+
+ir::Operand Reader::read_operand(std::uint64_t word, bool & forward) {
+  auto payload = std::uint32_t(word >> 32);
+  switch (word & 0xff) {
+  case ir::Operand::RESULT:
+    if (payload < this->results.size()) {
+      check(has_result(*this->results[payload]));
+      return this->results[payload];
+    }
+    forward = true;
+    return ir::Const{0};
+  case ir::Operand::CONST: return ir::Const{int(payload)};
+  case ir::Operand::ARG: return ir::Arg{int(payload)};
+  case ir::Operand::GLOBAL:
+    check(payload < this->symbols.size());
+    return this->symbols[payload];
+  default: throw "corrupt IR file";
+  }
+}
+
+ir::Program Reader::read() {
+  std::uint32_t start = 0;
+  for (auto end : this->symbol_ends) {
+    check(start <= end && end <= this->names.size());
+    this->symbols.push_back(intern(std::string_view(this->names.data() + start, end - start))); // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    start = end;
+  }
+
+  ir::Program program;
+  program.reserve(this->defs.size());
+  for (auto & def : this->defs) {
+    check(def.name < this->symbols.size());
+    auto name = this->symbols[def.name];
+    switch (def.kind) {
+    case FUNC: {
+      auto & func = std::get<ir::Func>(program.emplace_back(ir::Func{read_type(def.type), name, read_args(def)}));
+      read_func(func, def);
+      break;
+    }
+    case FUNC_DECL:
+      program.emplace_back(ir::FuncDecl{read_type(def.type), name, read_args(def)});
+      break;
+    case GLOBAL_VAR:
+      program.emplace_back(ir::GlobalVar{name, read_type(def.type), def.value});
+      break;
+    default: throw "corrupt IR file";
+    }
+  }
+  return program;
+}
+
+void Reader::read_func(ir::Func & func, const DefRecord & def) {
+  // a function has an entry block, and each block its terminator
+  check(def.block_count != 0);
+  auto blocks = slice(this->blocks, def.first_block, def.block_count);
+  this->labels.clear();
+  this->results.clear();
+  this->pending.clear();
+  for (std::size_t i = 0; i < blocks.size(); i++) {
+    this->labels.push_back(func.new_block());
+  }
+  this->first_instr = blocks.front().first_instr;
+  for (std::size_t i = 0; i < blocks.size(); i++) {
+    read_block(this->labels[i], blocks[i]);
+  }
+
+  for (auto [instr, record] : this->pending) {
+    auto operands = slice(this->words, record->first_word, record->word_count);
+    // a phi's sources are followed by their blocks
+    std::size_t stride = record->kind == PHI ? 2 : 1;
+    std::size_t i = 0;
+    foreach_operand(*instr, [this, operands, stride, &i](ir::Use & use) {
+      auto word = operands[i * stride];
+      i++;
+      if ((word & 0xff) != ir::Operand::RESULT || use.is<ir::Result>()) return;
+      auto index = std::uint32_t(word >> 32);
+      check(index < this->results.size() && has_result(*this->results[index]));
+      use = this->results[index];
+    });
+  }
+  for (std::size_t i = 0; i < blocks.size(); i++) {
+    this->labels[i]->terminator = read_terminator(blocks[i]);
+  }
+  check(phis_match_preds(func));
+}
+
+void Reader::read_block(ir::Label block, const BlockRecord & record) {
+  // the blocks of a function have its instructions in order
+  check(record.first_instr - this->first_instr == this->results.size());
+  for (auto & instr : slice(this->instrs, record.first_instr, record.instr_count)) {
+    bool forward = false;
+    auto result = block->push_back(read_instr(instr, forward));
+    this->results.push_back(result);
+    if (forward) this->pending.emplace_back(result, &instr);
+  }
+}
+
+ir::Instr Reader::read_instr(const InstrRecord & record, bool & forward) {
+  auto words = slice(this->words, record.first_word, record.word_count);
+  auto type = read_type(record.type);
+  auto operand = [this, words, &forward](std::size_t i) { return read_operand(words[i], forward); };
+  switch (record.kind) {
+  case ALLOCA:
+    check(words.empty());
+    return ir::Alloca{type};
+  case STORE:
+    check(words.size() == 2);
+    return ir::Store{type, operand(0), operand(1)};
+  case LOAD:
+    check(words.size() == 1);
+    return ir::Load{type, operand(0)};
+  case BINARY:
+    check(words.size() == 2 && record.op <= ir::Binary::OR);
+    return ir::Binary{ir::Binary::Op(record.op), type, operand(0), operand(1)};
+  case CALL: {
+    // the callee is a function's name
+    check(!words.empty() && (words[0] & 0xff) == ir::Operand::GLOBAL);
+    std::vector<std::pair<ir::Type, ir::Use>> args;
+    args.reserve(words.size() - 1);
+    for (std::size_t i = 1; i < words.size(); i++) {
+      args.emplace_back(read_type(std::uint8_t(words[i] >> 8)), operand(i));
+    }
+    return ir::Call{type, operand(0), std::move(args)};
+  }
+  case ZEXT:
+    check(words.size() == 1);
+    return ir::Zext{type, operand(0), read_type(record.to_type)};
+  case PHI: {
+    check(words.size() % 2 == 0);
+    ir::Phi phi{type};
+    phi.sources.reserve(words.size() / 2);
+    for (std::size_t i = 0; i < words.size(); i += 2) {
+      phi.sources.emplace_back(operand(i), read_label(std::uint32_t(words[i + 1] >> 32)));
+    }
+    return phi;
+  }
+  default: throw "corrupt IR file";
+  }
+}
+
+ir::Terminator Reader::read_terminator(const BlockRecord & record) {
+  // every instruction is there by now
+  bool forward = false;
+  ir::Terminator term;
+  switch (record.terminator) {
+  case RET: term = ir::Ret{read_type(record.type), read_operand(record.value, forward)}; break;
+  case BR: term = ir::Br{read_target(record.targets[0])}; break;
+  case BR_COND:
+    term = ir::BrCond{
+      read_operand(record.value, forward),
+      read_target(record.targets[0]),
+      read_target(record.targets[1]),
+    };
+    break;
+  default: throw "corrupt IR file";
+  }
+  check(!forward);
+  return term;
+}
+
+}
+
+bool is_ir_file(const char * begin, const char * end) {
+  return std::size_t(end - begin) >= sizeof(Header) && std::equal(magic.begin(), magic.end(), begin);
+}
+
+void write_ir_file(std::ostream & out, const ir::Program & program) {
+  Writer writer;
+  for (auto & def : program) {
+    writer.add(def);
+  }
+  writer.write(out);
+}
+
+ir::Program read_ir_file(const char * begin, const char * end) {
+  if (!is_ir_file(begin, end)) throw "not an IR file";
+  // the records are used in place, which needs them aligned; a mapped file
+  // is, but a buffer read from a stream may not be
+  std::vector<std::uint64_t> copy;
+  if (reinterpret_cast<std::uintptr_t>(begin) % alignof(std::uint64_t) != 0) { // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+    auto size = std::size_t(end - begin);
+    copy.resize((size + 7) / 8);
+    std::memcpy(copy.data(), begin, size);
+    begin = reinterpret_cast<const char *>(copy.data()); // NOLINT(cppcoreguidelines-pro-type-reinterpret-cast)
+    end = begin + size; // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+  }
+  return Reader{begin, end}.read();
+}
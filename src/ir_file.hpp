@@ -0,0 +1,25 @@
+#pragma once
+
+#include <iosfwd>
+
+#include "ir.hpp"
+
+// A binary form of an ir::Program, for handing IR from one tool to the next
+// without going through the front-end again. The file is a header followed
+// by arrays of fixed-size records: symbol names, definitions, blocks,
+// instructions and operands. Each definition refers to a range of blocks,
+// each block to a range of instructions, and each instruction to a range of
+// operands, by index. An operand that is the result of an instruction
+// holds that instruction's index within its function, and a phi's source
+// the index of its block within the function. Loading the file is a single
+// pass over these arrays, which can be used in place where the file is
+// memory-mapped. Numbers are in the byte order of the machine that wrote
+// the file. Vregs and labels aren't kept; assign_vregs gives them again.
+
+// whether the bytes from `begin` to `end` start like an IR file
+bool is_ir_file(const char * begin, const char * end);
+
+void write_ir_file(std::ostream & out, const ir::Program & program);
+
+// the program in the IR file from `begin` to `end`
+ir::Program read_ir_file(const char * begin, const char * end);
@@ -0,0 +1,406 @@
+#include <charconv>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "ir_parser.hpp"
+
+namespace {
+
+bool is_name_char(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+    || c == '_' || c == '.' || c == '$';
+}
+
+struct IrParser {
+  const char * pos;
+  const char * end;
+  // no number in the input can be larger
+  std::size_t max_number;
+
+  // the arguments, instructions and blocks of the current function, by number
+  std::size_t argc = 0;
+  std::vector<ir::InstrRef> values;
+  std::vector<ir::Label> labels;
+  std::uint32_t entry = 0;
+  // uses of values and blocks that may come later, set at the end of the function
+  std::vector<std::pair<ir::Use *, std::uint32_t>> value_fixups;
+  std::vector<std::pair<ir::Label *, std::uint32_t>> label_fixups;
+  // the operands of the instruction being parsed that use later values, by
+  // their position in foreach_operand order, and the blocks of a phi's sources
+  std::size_t operand_count = 0;
+  std::vector<std::pair<std::size_t, std::uint32_t>> forward;
+  std::vector<std::uint32_t> phi_labels;
+
+  IrParser(const char * begin, const char * end) :
+    pos(begin), end(end), max_number(std::size_t(end - begin)) {}
+
+  void skip_space();
+  bool accept(std::string_view text);
+  void expect(std::string_view text);
+  std::string_view word();
+  std::uint32_t number();
+  int integer();
+  Sym global_name();
+  ir::Type type();
+  ir::Operand operand();
+  std::uint32_t label();
+  std::uint32_t target();
+  std::optional<ir::Binary::Op> binary_op(std::string_view op);
+
+  template<typename T>
+  void defer_forward(T & parsed);
+  void define(std::uint32_t number, ir::InstrRef instr);
+  void define(std::uint32_t number, ir::Label block);
+
+  ir::Program program();
+  void func(ir::Program & program);
+  void statement(ir::Label block);
+  ir::Instr instr(std::string_view op);
+};
+
+void IrParser::skip_space() {
+  while (this->pos != this->end) {
+    char c = *this->pos;
+    if (c == ';') {
+      while (this->pos != this->end && *this->pos != '\n') this->pos++;
+    } else if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+      this->pos++;
+    } else {
+      break;
+    }
+  }
+}
+
+// takes `text` if it comes next, and a keyword only as a whole word
+bool IrParser::accept(std::string_view text) {
+  skip_space();
+  if (std::size_t(this->end - this->pos) < text.size() || std::string_view(this->pos, text.size()) != text) return false;
+  const char * after = this->pos + text.size(); // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+  if (is_name_char(text.back()) && after != this->end && is_name_char(*after)) return false;
+  this->pos = after;
+  return true;
+}
+
+void IrParser::expect(std::string_view text) {
+  if (!accept(text)) throw "unexpected text in IR";
+}
+
+// the keyword or name that comes next, which may be empty
+std::string_view IrParser::word() {
+  skip_space();
+  const char * start = this->pos;
+  while (this->pos != this->end && is_name_char(*this->pos)) this->pos++;
+  return {start, std::size_t(this->pos - start)};
+}
+
+std::uint32_t IrParser::number() {
+  skip_space();
+  std::uint32_t value = 0;
+  auto [after, error] = std::from_chars(this->pos, this->end, value);
+  if (error != std::errc{} || value > this->max_number) throw "expected a number in IR";
+  this->pos = after;
+  return value;
+}
+
+int IrParser::integer() {
+  skip_space();
+  int value = 0;
+  auto [after, error] = std::from_chars(this->pos, this->end, value);
+  if (error != std::errc{}) throw "expected an integer in IR";
+  this->pos = after;
+  return value;
+}
+
+Sym IrParser::global_name() {
+  expect("@");
+  auto name = word();
+  if (name.empty()) throw "expected a name in IR";
+  return intern(name);
+}
+
+ir::Type IrParser::type() {
+  auto type = word();
+  if (type == "i32") return ir::I32;
+  if (type == "i1") return ir::I1;
+  if (type == "ptr") return ir::PTR;
+  if (type == "void") return ir::VOID;
+  if (type == "label") return ir::LABEL;
+  throw "expected a type in IR";
+}
+
+ir::Operand IrParser::operand() {
+  auto index = this->operand_count++;
+  skip_space();
+  if (this->pos != this->end && *this->pos == '@') return global_name();
+  if (!accept("%")) return ir::Const{integer()};
+  auto number = this->number();
+  if (number < this->argc) return ir::Arg{int(number)};
+  if (number < this->values.size() && this->values[number] != ir::InstrRef()) return this->values[number];
+  this->forward.emplace_back(index, number);
+  return ir::Const{0};
+}
+
+std::uint32_t IrParser::label() {
+  expect("%");
+  return number();
+}
+
+// nothing branches to the entry block
+std::uint32_t IrParser::target() {
+  auto number = label();
+  if (number == this->entry) throw "branch to the entry block in IR";
+  return number;
+}
+
+std::optional<ir::Binary::Op> IrParser::binary_op(std::string_view op) {
+  if (op == "add") return ir::Binary::ADD;
+  if (op == "sub") return ir::Binary::SUB;
+  if (op == "mul") return ir::Binary::MUL;
+  if (op == "sdiv") return ir::Binary::SDIV;
+  if (op == "srem") return ir::Binary::SREM;
+  if (op == "and") return ir::Binary::AND;
+  if (op == "or") return ir::Binary::OR;
+  if (op != "icmp") return std::nullopt;
+  auto cond = word();
+  if (cond == "slt") return ir::Binary::ICMP_SLT;
+  if (cond == "sle") return ir::Binary::ICMP_SLE;
+  if (cond == "sgt") return ir::Binary::ICMP_SGT;
+  if (cond == "sge") return ir::Binary::ICMP_SGE;
+  if (cond == "eq") return ir::Binary::ICMP_EQ;
+  if (cond == "ne") return ir::Binary::ICMP_NE;
+  throw "unknown comparison in IR";
+}
+
+// the operands of `parsed` that use later values are set at the end of
+// the function, through their uses
+template<typename T>
+void IrParser::defer_forward(T & parsed) {
+  if (!this->forward.empty()) {
+    std::size_t index = 0;
+    auto next = this->forward.begin();
+    foreach_operand(parsed, [this, &index, &next](ir::Use & use) {
+      if (next != this->forward.end() && next->first == index) {
+        this->value_fixups.emplace_back(&use, next->second);
+        ++next;
+      }
+      index++;
+    });
+    this->forward.clear();
+  }
+  this->operand_count = 0;
+}
+
+void IrParser::define(std::uint32_t number, ir::InstrRef instr) {
+  if (number < this->argc) throw "value defined twice in IR";
+  if (number >= this->values.size()) this->values.resize(number + 1);
+  if (this->values[number] != ir::InstrRef()) throw "value defined twice in IR";
+  this->values[number] = instr;
+}
+
+void IrParser::define(std::uint32_t number, ir::Label block) {
+  if (number >= this->labels.size()) this->labels.resize(number + 1);
+  if (this->labels[number] != nullptr) throw "block defined twice in IR";
+  this->labels[number] = block;
+}
+
+ir::Program IrParser::program() {
+  ir::Program program;
+  while (skip_space(), this->pos != this->end) {
+    if (accept("define")) {
+      func(program);
+    } else if (accept("declare")) {
+      auto rettype = type();
+      auto name = global_name();
+      std::vector<ir::Type> args;
+      expect("(");
+      if (!accept(")")) {
+        do args.push_back(type()); while (accept(","));
+        expect(")");
+      }
+      program.emplace_back(ir::FuncDecl{rettype, name, std::move(args)});
+    } else {
+      auto name = global_name();
+      expect("=");
+      expect("dso_local");
+      expect("global");
+      auto type = this->type();
+      program.emplace_back(ir::GlobalVar{name, type, integer()});
+    }
+  }
+  return program;
+}
+
+void IrParser::func(ir::Program & program) {
+  expect("dso_local");
+  auto rettype = type();
+  auto name = global_name();
+  std::vector<ir::Type> args;
+  expect("(");
+  if (!accept(")")) {
+    do {
+      args.push_back(type());
+      expect("%");
+      if (number() != args.size() - 1) throw "arguments out of order in IR";
+    } while (accept(","));
+    expect(")");
+  }
+  expect("{");
+  auto & func = std::get<ir::Func>(program.emplace_back(ir::Func{rettype, name, std::move(args)}));
+
+  this->argc = func.args.size();
+  this->values.clear();
+  this->labels.clear();
+  this->value_fixups.clear();
+  this->label_fixups.clear();
+  ir::Label block = nullptr;
+  while (!accept("}")) {
+    skip_space();
+    if (this->pos != this->end && *this->pos >= '0' && *this->pos <= '9') {
+      auto number = this->number();
+      expect(":");
+      if (block != nullptr && !block->terminated()) throw "block without terminator in IR";
+      if (block == nullptr) this->entry = number;
+      block = func.new_block();
+      define(number, block);
+      continue;
+    }
+    if (block == nullptr) {
+      // the entry block is numbered after the arguments
+      this->entry = std::uint32_t(this->argc);
+      block = func.new_block();
+      define(this->entry, block);
+    } else if (block->terminated()) {
+      throw "instruction after terminator in IR";
+    }
+    statement(block);
+  }
+  if (block == nullptr || !block->terminated()) throw "block without terminator in IR";
+
+  for (auto [use, number] : this->value_fixups) {
+    if (number >= this->values.size() || this->values[number] == ir::InstrRef()) throw "undefined value in IR";
+    *use = this->values[number];
+  }
+  for (auto [label, number] : this->label_fixups) {
+    if (number >= this->labels.size() || this->labels[number] == nullptr) throw "undefined block in IR";
+    *label = this->labels[number];
+  }
+  if (!phis_match_preds(func)) throw "phi sources don't match predecessors in IR";
+}
+
+void IrParser::statement(ir::Label block) {
+  std::optional<std::uint32_t> result;
+  if (accept("%")) {
+    result = number();
+    expect("=");
+  }
+  auto op = word();
+  // terminators have no results
+  if (!result.has_value() && op == "ret") {
+    ir::Ret ret{type()};
+    if (ret.type != ir::VOID) ret.retval = operand();
+    block->terminator = std::move(ret);
+    defer_forward(block->terminator);
+    return;
+  }
+  if (!result.has_value() && op == "br") {
+    if (accept("label")) {
+      block->terminator = ir::Br{nullptr};
+      this->label_fixups.emplace_back(&std::get<ir::Br>(block->terminator).dest, target());
+      return;
+    }
+    expect("i1");
+    auto cond = operand();
+    expect(",");
+    expect("label");
+    auto iftrue = target();
+    expect(",");
+    expect("label");
+    auto iffalse = target();
+    auto & br = block->terminator.emplace<ir::BrCond>(ir::BrCond{cond, nullptr, nullptr});
+    this->label_fixups.emplace_back(&br.iftrue, iftrue);
+    this->label_fixups.emplace_back(&br.iffalse, iffalse);
+    defer_forward(block->terminator);
+    return;
+  }
+
+  auto instr = block->push_back(this->instr(op));
+  defer_forward(*instr);
+  if (auto phi = std::get_if<ir::Phi>(&*instr)) {
+    for (std::size_t i = 0; i < this->phi_labels.size(); i++) {
+      this->label_fixups.emplace_back(&phi->sources[i].second, this->phi_labels[i]);
+    }
+    this->phi_labels.clear();
+  }
+  // the printer names exactly the instructions with results
+  if (result.has_value() != has_result(*instr)) {
+    throw result.has_value() ? "named instruction without a result in IR" : "unnamed result in IR";
+  }
+  if (result.has_value()) define(*result, instr);
+}
+
+ir::Instr IrParser::instr(std::string_view op) {
+  if (op == "alloca") return ir::Alloca{type()};
+  if (op == "load") {
+    auto type = this->type();
+    expect(",");
+    expect("ptr");
+    return ir::Load{type, operand()};
+  }
+  if (op == "store") {
+    auto type = this->type();
+    auto from = operand();
+    expect(",");
+    expect("ptr");
+    return ir::Store{type, from, operand()};
+  }
+  if (op == "call") {
+    auto type = this->type();
+    // the callee is always a function's name, but counts as an operand
+    this->operand_count++;
+    ir::Operand func = global_name();
+    std::vector<std::pair<ir::Type, ir::Use>> args;
+    expect("(");
+    if (!accept(")")) {
+      do {
+        auto arg_type = this->type();
+        args.emplace_back(arg_type, operand());
+      } while (accept(","));
+      expect(")");
+    }
+    return ir::Call{type, func, std::move(args)};
+  }
+  if (op == "zext") {
+    auto from_type = type();
+    auto value = operand();
+    expect("to");
+    return ir::Zext{from_type, value, type()};
+  }
+  if (op == "phi") {
+    ir::Phi phi{type()};
+    do {
+      expect("[");
+      auto value = operand();
+      expect(",");
+      this->phi_labels.push_back(label());
+      expect("]");
+      phi.sources.emplace_back(value, nullptr);
+    } while (accept(","));
+    return phi;
+  }
+  if (auto binary = binary_op(op)) {
+    auto type = this->type();
+    auto lhs = operand();
+    expect(",");
+    return ir::Binary{*binary, type, lhs, operand()};
+  }
+  throw "unknown instruction in IR";
+}
+
+}
+
+ir::Program parse_ir(const char * begin, const char * end) {
+  return IrParser{begin, end}.program();
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "ir.hpp"
+
+// Parses the LLVM IR that operator<< prints for an ir::Program back into a
+// program, so passes can run on IR without the front-end. Values and
+// blocks are numbered as LLVM numbers them, which is how assign_vregs
+// numbers them too; the entry block may go without its label. Named
+// values and anything else outside what the printer emits aren't
+// accepted. Comments and blank space are skipped.
+ir::Program parse_ir(const char * begin, const char * end);
@@ -1,109 +1,223 @@
+#include <array>
+#include <charconv>
+#include <cstdio>
 #include <istream>
+#include <limits>
+#include <string_view>
 
 #include "lexer.hpp"
+#include "parallel.hpp"
+#include "scan.hpp"
 
-Lexer::Lexer(std::istream & in_) : in(in_), has_next(false) {}
+Lexer::Lexer(std::istream & in_)
+  : in(&in_), cur(nullptr), end(nullptr), has_next(false) {}
 
-static bool is_nondigit(int c) {
-  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c == '_');
-}
+Lexer::Lexer(const char * begin, const char * end_)
+  : in(nullptr), cur(begin), end(end_), has_next(false) {}
 
-static bool is_digit(int c) {
-  return c >= '0' && c <= '9';
-}
+// character classes, one table lookup per character
+enum CharClass : unsigned char {
+  NONDIGIT = 1,
+  DIGIT = 2,
+  SPACE = 4,
+  IDENT = NONDIGIT | DIGIT,
+};
 
-static bool is_space(int c) {
-  return c == ' ' || c == '\r' || c == '\n' || c == '\t';
+static constexpr std::array<unsigned char, 256> char_classes = [] {
+  std::array<unsigned char, 256> table{};
+  for (int c = 'a'; c <= 'z'; c++) table[c] = NONDIGIT;
+  for (int c = 'A'; c <= 'Z'; c++) table[c] = NONDIGIT;
+  table['_'] = NONDIGIT;
+  for (int c = '0'; c <= '9'; c++) table[c] = DIGIT;
+  for (int c : {' ', '\r', '\n', '\t'}) table[c] = SPACE;
+  return table;
+}();
+
+// EOF maps to 255, which is in no class
+static inline bool has_class(int c, CharClass cls) {
+  return (char_classes[static_cast<unsigned char>(c)] & cls) != 0;
 }
 
-// given the head of an identifier, consume the rest of it and output it
-Token Lexer::lex_ident(std::string && head) {
-  int c; // NOLINT(cppcoreguidelines-init-variables)
-  while (true) {
-    c = in.peek();
-    if (is_nondigit(c) || is_digit(c)) {
-      head.push_back(char(c));
-      in.get();
-    } else {
-      break;
+static inline bool is_nondigit(int c) { return has_class(c, NONDIGIT); }
+static inline bool is_digit(int c) { return has_class(c, DIGIT); }
+static inline bool is_space(int c) { return has_class(c, SPACE); }
+
+namespace {
+
+// character source over a std::istream
+struct StreamInput {
+  std::istream & in; // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
+  // storage for the lexeme being scanned
+  std::string text;
+
+  inline int peek() { return in.peek(); }
+  inline int get() { return in.get(); }
+  inline void mark() {}
+
+  inline void skip_space() {
+    while (is_space(in.peek())) in.get();
+  }
+
+  // after "//", consume the rest of the line
+  inline void skip_line_comment() {
+    int c; // NOLINT(cppcoreguidelines-init-variables)
+    do c = in.get(); while (c != '\n' && c != EOF);
+  }
+
+  // after "/*", consume through "*/"; false if there is none
+  inline bool skip_block_comment() {
+    for (int c = in.get(); c != EOF; c = in.get()) {
+      if (c == '*' && in.peek() == '/') {
+        in.get();
+        return true;
+      }
     }
+    return false;
   }
-  return std::move(head);
-}
 
-// consume `tail` and output `token`;
-// if failed, try to consume an identifier instead
-Token Lexer::lex_keyword(std::string && head, const char * tail, Token::Tag tok) {
-  for (; *tail != '\0'; tail++) { // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
-    if (in.peek() == *tail) {
-      head.push_back(char(in.get()));
-    } else {
-      return lex_ident(std::move(head));
+  // given the already consumed first character of a lexeme,
+  // consume the rest of it (characters in `cls`) and output all of it
+  inline std::string_view take_lexeme(int first, CharClass cls) {
+    text.assign(1, char(first));
+    while (has_class(in.peek(), cls)) {
+      text.push_back(char(in.get()));
     }
+    return text;
   }
-  // this would prevent "returna" from being parsed as Return\nIdent(a)
-  if (is_nondigit(in.peek())) {
-    return lex_ident(std::move(head));
+};
+
+// character source over a contiguous buffer
+struct BufferInput {
+  const char * cur;
+  const char * end;
+  // where the last token begins
+  const char * start = nullptr;
+
+  // NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+  inline int peek() { return cur != end ? static_cast<unsigned char>(*cur) : EOF; }
+  inline int get() { return cur != end ? static_cast<unsigned char>(*cur++) : EOF; }
+  inline void mark() { start = cur; }
+
+  inline void skip_space() {
+    if (cur != end && is_space(*cur)) cur = ::skip_space(cur + 1, end);
   }
-  return tok;
-}
 
-// consume any space plus possibly one token; output that token
-Token Lexer::lex_incl_space() {
-  int c = in.get();
-  if (is_nondigit(c)) {
-    std::string head{char(c)};
-    switch (c) {
-    case 'i':
-      c = in.peek();
-      if (!(is_nondigit(c) || is_digit(c))) return Token(std::move(head));
-      in.get();
-      head.push_back(char(c));
-      switch (c) {
-        case 'f': return Token::IF;
-        case 'n': return lex_keyword(std::move(head), "t", Token::INT);
-        default: return lex_ident(std::move(head));
-      }
-    case 'e': return lex_keyword(std::move(head), "lse", Token::ELSE);
-    case 'w': return lex_keyword(std::move(head), "hile", Token::WHILE);
-    case 'b': return lex_keyword(std::move(head), "reak", Token::BREAK);
-    case 'c':
-      c = in.peek();
-      if (!(is_nondigit(c) || is_digit(c))) return Token(std::move(head));
-      in.get();
-      head.push_back(char(c));
-      if (c != 'o') return lex_ident(std::move(head));
-      c = in.peek();
-      if (!(is_nondigit(c) || is_digit(c))) return Token(std::move(head));
-      in.get();
-      head.push_back(char(c));
-      if (c != 'n') return lex_ident(std::move(head));
-      c = in.peek();
-      if (!(is_nondigit(c) || is_digit(c))) return Token(std::move(head));
-      in.get();
-      head.push_back(char(c));
-      switch (c) {
-        case 's': return lex_keyword(std::move(head), "t", Token::CONST);
-        case 't': return lex_keyword(std::move(head), "inue", Token::CONTINUE);
-        default: return lex_ident(std::move(head));
-      }
-    case 'r': return lex_keyword(std::move(head), "eturn", Token::RETURN);
-    case 'v': return lex_keyword(std::move(head), "oid", Token::VOID);
-    default: return lex_ident(std::move(head));
+  inline void skip_line_comment() {
+    cur = find_newline(cur, end);
+    if (cur != end) cur++;
+  }
+
+  inline bool skip_block_comment() {
+    const char * star = find_comment_end(cur, end);
+    if (star == end) {
+      cur = end;
+      return false;
     }
+    cur = star + 2;
+    return true;
   }
-  if (is_digit(c)) {
-    std::string num{char(c)};
-    while (is_digit(in.peek())) {
-      num.push_back(char(in.get()));
+
+  inline std::string_view take_lexeme(int /* first */, CharClass cls) {
+    const char * begin = cur - 1;
+    while (cur != end && has_class(*cur, cls)) cur++;
+    return {begin, std::size_t(cur - begin)};
+  }
+  // NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+};
+
+}
+
+// keyword recognition by a perfect hash over (length, first, last character)
+
+struct Keyword {
+  std::string_view text;
+  Token::Tag tag;
+};
+
+static constexpr std::array keywords{
+  Keyword{"if", Token::IF},
+  Keyword{"else", Token::ELSE},
+  Keyword{"while", Token::WHILE},
+  Keyword{"break", Token::BREAK},
+  Keyword{"continue", Token::CONTINUE},
+  Keyword{"return", Token::RETURN},
+  Keyword{"const", Token::CONST},
+  Keyword{"int", Token::INT},
+  Keyword{"void", Token::VOID},
+};
+
+static constexpr std::size_t keyword_table_size = 16;
+static constexpr std::size_t keyword_min_len = 2;
+static constexpr std::size_t keyword_max_len = 8;
+
+static constexpr std::size_t keyword_hash(std::string_view word, unsigned seed) {
+  auto first = static_cast<unsigned char>(word.front());
+  auto last = static_cast<unsigned char>(word.back());
+  return (first * seed + last + word.size()) % keyword_table_size;
+}
+
+// the smallest seed that maps all keywords to distinct slots
+static constexpr unsigned keyword_seed = [] {
+  constexpr unsigned max_seed = 1024;
+  for (unsigned seed = 1; seed < max_seed; seed++) {
+    std::array<bool, keyword_table_size> used{};
+    bool collision = false;
+    for (auto & kw : keywords) {
+      auto slot = keyword_hash(kw.text, seed);
+      collision = collision || used.at(slot);
+      used.at(slot) = true;
     }
-    return std::stoi(num);
+    if (!collision) return seed;
   }
-  if (is_space(c)) {
-    while (is_space(in.peek())) {
+  return 0U;
+}();
+static_assert(keyword_seed != 0, "no perfect hash for the keywords");
+
+static constexpr std::array<Keyword, keyword_table_size> keyword_table = [] {
+  std::array<Keyword, keyword_table_size> table{};
+  for (auto & slot : table) slot = Keyword{"", Token::IDENT};
+  for (auto & kw : keywords) table.at(keyword_hash(kw.text, keyword_seed)) = kw;
+  return table;
+}();
+
+// the keyword spelled by `word`, or IDENT
+static inline Token::Tag keyword_tag(std::string_view word) {
+  if (word.size() < keyword_min_len || word.size() > keyword_max_len) return Token::IDENT;
+  auto & slot = keyword_table[keyword_hash(word, keyword_seed)];
+  return slot.text == word ? slot.tag : Token::IDENT;
+}
+
+// consume any space and comments plus possibly one token; output that token
+template<typename Input>
+static Token lex(Input & in) {
+  int c; // NOLINT(cppcoreguidelines-init-variables)
+  while (true) {
+    in.skip_space();
+    in.mark();
+    c = in.get();
+    if (c != '/') break;
+    if (in.peek() == '/') {
+      in.skip_line_comment();
+    } else if (in.peek() == '*') {
       in.get();
+      // unterminated /* comment
+      if (!in.skip_block_comment()) return Token::ERR;
+    } else {
+      return Token::DIV;
     }
-    return Token::SPACE;
+  }
+  if (is_nondigit(c)) {
+    auto word = in.take_lexeme(c, IDENT);
+    auto tag = keyword_tag(word);
+    if (tag != Token::IDENT) return tag;
+    return Token(intern(word));
+  }
+  if (is_digit(c)) {
+    auto digits = in.take_lexeme(c, DIGIT);
+    int value = 0;
+    auto [_, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), value); // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    if (ec != std::errc{}) throw "integer literal out of range";
+    return value;
   }
   switch (c) {
   case '=':
@@ -122,32 +236,6 @@ Token Lexer::lex_incl_space() {
   case '+': return Token::PLUS;
   case '-': return Token::MINUS;
   case '*': return Token::MULT;
-  case '/':
-    if (in.peek() == '/') {
-      while (in.good()) {
-        in.get();
-        if (in.peek() == '\n') {
-          in.get();
-          break;
-        }
-      }
-      return Token::COMMENT;
-    } else if (in.peek() == '*') {
-      while (in.good()) {
-        in.get();
-        if (in.peek() == '*') {
-          in.get();
-          if (in.peek() == '/') {
-            in.get();
-            return Token::COMMENT;
-          }
-        }
-      }
-      // Unterminated /* comment
-      return Token::ERR;
-    } else {
-      return Token::DIV;
-    }
   case '%': return Token::MOD;
   case '<':
     if (in.peek() == '=') {
@@ -187,26 +275,232 @@ Token Lexer::lex_incl_space() {
   }
 }
 
+Token Lexer::lex() {
+  if (in != nullptr) {
+    StreamInput input{*in};
+    return ::lex(input);
+  }
+  BufferInput input{cur, end};
+  Token tok = ::lex(input);
+  cur = input.cur;
+  return tok;
+}
+
 Token Lexer::get() {
   if (has_next) {
     has_next = false;
     return std::move(next);
   }
-  Token tok = lex_incl_space();
-  while (tok.tag == Token::SPACE || tok.tag == Token::COMMENT) {
-    tok = lex_incl_space();
-  }
-  return tok;
+  return lex();
 }
 
 const Token & Lexer::peek() {
   if (has_next) {
     return next;
   }
-  next = lex_incl_space();
-  while (next.tag == Token::SPACE || next.tag == Token::COMMENT) {
-    next = lex_incl_space();
-  }
+  next = lex();
   has_next = true;
   return next;
 }
+
+Token TokenArray::operator[](std::size_t i) const {
+  switch (tags[i]) {
+  case Token::IDENT: return Sym{values[i]};
+  case Token::NUMBER: return int(values[i]);
+  default: return tags[i];
+  }
+}
+
+void TokenArray::push_back(const Token & tok, std::uint32_t offset, std::uint32_t length) {
+  tags.push_back(tok.tag);
+  offsets.push_back(offset);
+  lengths.push_back(length);
+  switch (tok.tag) {
+  case Token::IDENT: values.push_back(tok.ident.id); break; // NOLINT(cppcoreguidelines-pro-type-union-access)
+  case Token::NUMBER: values.push_back(std::uint32_t(tok.number)); break; // NOLINT(cppcoreguidelines-pro-type-union-access)
+  default: values.push_back(0); break;
+  }
+}
+
+void TokenArray::append(const TokenArray & other, std::size_t from) {
+  auto tail = [from](auto & column, auto & other_column) {
+    column.insert(column.end(), other_column.begin() + std::ptrdiff_t(from), other_column.end());
+  };
+  tail(tags, other.tags);
+  tail(offsets, other.offsets);
+  tail(lengths, other.lengths);
+  tail(values, other.values);
+}
+
+void TokenArray::reserve(std::size_t count) {
+  tags.reserve(count);
+  offsets.reserve(count);
+  lengths.reserve(count);
+  values.reserve(count);
+}
+
+// lex from `input` until the end of input, an error,
+// or a token that starts at or after `limit`, which is left unconsumed
+static void lex_until(BufferInput & input, const char * limit, const char * begin, TokenArray & tokens) {
+  while (true) {
+    const char * before = input.cur;
+    Token tok = lex(input);
+    if (input.start >= limit && tok.tag != Token::ERR) {
+      input.cur = before;
+      return;
+    }
+    tokens.push_back(
+      tok,
+      std::uint32_t(input.start - begin),
+      std::uint32_t(input.cur - input.start)
+    );
+    if (tok.tag == Token::ERR) return;
+  }
+}
+
+static TokenArray lex_serial(const char * begin, const char * end) {
+  TokenArray tokens;
+  // about one token per 4 bytes on typical sources
+  tokens.reserve(std::size_t(end - begin) / 4); // NOLINT(cppcoreguidelines-avoid-magic-numbers)
+  BufferInput input{begin, end};
+  lex_until(input, end, begin, tokens);
+  return tokens;
+}
+
+namespace {
+
+// a part of the input, lexed speculatively by a worker thread
+// as if its beginning were not inside a comment
+struct Chunk {
+  const char * begin;
+  const char * end;
+  // the tokens starting in [begin, end)
+  TokenArray tokens;
+  // where lexing continues after the last token
+  const char * resume;
+  // the speculation threw before reaching `end`
+  bool failed;
+};
+
+}
+
+static void lex_chunk(Chunk & chunk, const char * begin, const char * end) {
+  BufferInput input{chunk.begin, end};
+  chunk.failed = false;
+  try {
+    lex_until(input, chunk.end, begin, chunk.tokens);
+    chunk.resume = input.cur;
+  } catch (const char *) {
+    // maybe we started inside a comment; the stitching decides
+    chunk.failed = true;
+    // `input` stopped in the middle of the failed token
+    chunk.resume = chunk.tokens.size() == 0
+      ? chunk.begin
+      : begin + chunk.tokens.offsets.back() + chunk.tokens.lengths.back();
+  }
+}
+
+// Appends the tokens starting in `chunk` to `tokens`, given that the serial
+// lexer would continue at `resume`; outputs where it continues afterwards.
+//
+// We lex serially from `resume` until a token starts exactly where one of the
+// speculative tokens starts. Lexing only depends on the position, so from
+// there on the speculative tokens are the serial ones. Usually the very first
+// token matches; a chunk that began inside a block comment re-syncs after it.
+static const char * stitch_chunk(
+  const Chunk & chunk, const char * resume,
+  const char * begin, const char * end, TokenArray & tokens
+) {
+  BufferInput input{resume, end};
+  std::size_t spec = 0;
+  while (true) {
+    const char * before = input.cur;
+    Token tok = lex(input);
+    if (input.start >= chunk.end && tok.tag != Token::ERR) {
+      return before;
+    }
+    auto offset = std::uint32_t(input.start - begin);
+    while (spec < chunk.tokens.size() && chunk.tokens.offsets[spec] < offset) spec++;
+    if (spec < chunk.tokens.size() && chunk.tokens.offsets[spec] == offset) break;
+    tokens.push_back(tok, offset, std::uint32_t(input.cur - input.start));
+    if (tok.tag == Token::ERR) return end;
+  }
+  // synced: take the rest of the speculation
+  tokens.append(chunk.tokens, spec);
+  if (tokens.tags.back() == Token::ERR) return end;
+  if (chunk.failed) {
+    // the speculation stopped at a real error; lex it again to raise it
+    BufferInput rest{chunk.resume, end};
+    lex_until(rest, chunk.end, begin, tokens);
+    return tokens.tags.back() == Token::ERR ? end : rest.cur;
+  }
+  return chunk.resume;
+}
+
+TokenArray lex_all(const char * begin, const char * end, unsigned jobs) {
+  if (end - begin > std::numeric_limits<std::uint32_t>::max()) {
+    throw "input too large for 32-bit token offsets";
+  }
+  // below this, a thread costs more than it saves
+  constexpr std::size_t min_chunk = std::size_t(1) << 16;
+  auto size = std::size_t(end - begin);
+  auto chunk_count = std::min<std::size_t>(jobs, size / min_chunk);
+  if (chunk_count <= 1) {
+    return lex_serial(begin, end);
+  }
+
+  // split at line starts, which can only be inside a block comment
+  std::vector<Chunk> chunks;
+  const char * chunk_begin = begin;
+  for (std::size_t i = 1; i <= chunk_count; i++) {
+    const char * chunk_end = end;
+    if (i < chunk_count) {
+      chunk_end = begin + size / chunk_count * i;
+      if (chunk_end < chunk_begin) chunk_end = chunk_begin;
+      chunk_end = find_newline(chunk_end, end);
+      if (chunk_end != end) chunk_end++;
+    }
+    if (chunk_end != chunk_begin) {
+      chunks.push_back(Chunk{chunk_begin, chunk_end, {}, nullptr, false});
+    }
+    chunk_begin = chunk_end;
+  }
+
+  parallel_for(chunks.size(), jobs, [&chunks, begin, end](std::size_t i) {
+    auto & chunk = chunks[i];
+    chunk.tokens.reserve(std::size_t(chunk.end - chunk.begin) / 4); // NOLINT(cppcoreguidelines-avoid-magic-numbers)
+    lex_chunk(chunk, begin, end);
+  });
+
+  TokenArray tokens;
+  tokens.reserve(size / 4); // NOLINT(cppcoreguidelines-avoid-magic-numbers)
+  const char * resume = begin;
+  for (auto & chunk : chunks) {
+    if (resume == end) break;
+    resume = stitch_chunk(chunk, resume, begin, end, tokens);
+  }
+  if (tokens.size() == 0 || tokens.tags.back() != Token::ERR) {
+    tokens.push_back(Token::ERR, std::uint32_t(size), 0);
+  }
+  return tokens;
+}
+
+TokenArray relex(const char * begin, const char * end, std::span<const std::size_t> stops) {
+  if (end - begin > std::numeric_limits<std::uint32_t>::max()) {
+    throw "input too large for 32-bit token offsets";
+  }
+  TokenArray tokens;
+  BufferInput input{begin, end};
+  std::size_t stop = 0;
+  while (true) {
+    Token tok = lex(input);
+    auto offset = std::size_t(input.start - begin);
+    while (stop < stops.size() && stops[stop] < offset) stop++;
+    if (stop < stops.size() && stops[stop] == offset) {
+      tokens.push_back(Token::ERR, std::uint32_t(offset), 0);
+      return tokens;
+    }
+    tokens.push_back(tok, std::uint32_t(offset), std::uint32_t(input.cur - input.start));
+    if (tok.tag == Token::ERR) return tokens;
+  }
+}
@@ -1,19 +1,84 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iosfwd>
+#include <span>
+#include <vector>
+
 #include "token.hpp"
 
 struct Lexer {
 private:
-  std::istream & in; // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
+  // stream mode reads through `in` one character at a time;
+  // buffer mode (`in == nullptr`) scans [cur, end) with raw pointers
+  std::istream * in;
+  const char * cur;
+  const char * end;
   bool has_next;
   Token next;
 
 public:
   Lexer(std::istream & in);
+  Lexer(const char * begin, const char * end);
 
   Token get();
   const Token & peek();
 
 private:
-  Token lex_ident(std::string && head);
-  Token lex_keyword(std::string && head, const char * tail, Token::Tag tok);
-  Token lex_incl_space();
+  Token lex();
+};
+
+// The whole input lexed up front, stored column-wise.
+// The last token is always ERR, at the end of input or at the first error.
+struct TokenArray {
+  std::vector<Token::Tag> tags;
+  // source span of each token, relative to the beginning of the input
+  std::vector<std::uint32_t> offsets;
+  std::vector<std::uint32_t> lengths;
+  // Token::ident or Token::number, depending on the tag
+  std::vector<std::uint32_t> values;
+
+  [[nodiscard]] inline std::size_t size() const {
+    return tags.size();
+  }
+  Token operator[](std::size_t i) const;
+
+  void push_back(const Token & tok, std::uint32_t offset, std::uint32_t length);
+  // appends other[from..]
+  void append(const TokenArray & other, std::size_t from);
+  void reserve(std::size_t count);
+};
+
+// with jobs > 1, large inputs are split into chunks lexed on that many
+// threads; the result is the same as lexing serially
+TokenArray lex_all(const char * begin, const char * end, unsigned jobs = 1);
+
+// Lexes from `begin` like lex_all, but ends the result with an empty ERR
+// instead of the first token that starts at one of `stops` (increasing
+// offsets from `begin`). Lexing only depends on the position, so this
+// re-lexes an edited range until it meets the old tokens again.
+TokenArray relex(const char * begin, const char * end, std::span<const std::size_t> stops);
+
+// Walks a TokenArray with the interface of Lexer, plus lookahead.
+struct TokenCursor {
+private:
+  const TokenArray & tokens; // NOLINT(cppcoreguidelines-avoid-const-or-ref-data-members)
+  std::size_t pos;
+
+public:
+  inline TokenCursor(const TokenArray & tokens_, std::size_t pos_ = 0) : tokens(tokens_), pos(pos_) {}
+
+  // index of the next token
+  [[nodiscard]] inline std::size_t position() const {
+    return pos;
+  }
+
+  // the final ERR is never consumed
+  inline Token get() {
+    return tokens[pos + 1 < tokens.size() ? pos++ : pos];
+  }
+  [[nodiscard]] inline Token peek(std::size_t ahead = 0) const {
+    return tokens[std::min(pos + ahead, tokens.size() - 1)];
+  }
 };
@@ -1,17 +1,204 @@
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <optional>
+#include <thread>
 
 #include "parser.hpp"
 #include "codegen.hpp"
+#include "flat_ast.hpp"
+#include "ir_file.hpp"
+#include "ir_parser.hpp"
+#include "remove_dead.hpp"
+#include "simplify_cfg.hpp"
+#include "source.hpp"
+#include "timer.hpp"
 
-int main() {
-  try {
-    Lexer lexer{std::cin};
-    auto ast = parse(lexer);
-    Codegen codegen;
-    codegen.add_program(ast);
-    auto program = std::move(codegen).get();
+// usage: a.out [--stream | --lazy-lex | --jobs N] [--lex-only | --parse-only | --emit-each] [--flat-ast] [--fold] [--short-circuit] [--ssa] [--simplify-cfg] [--remove-dead] [--read-ll] [--write-ir] [--time] [file]
+//   --stream      lex through std::istream instead of a whole-input buffer
+//   --lazy-lex    lex the buffer on demand instead of into a token array first
+//   --jobs N      use up to N threads
+//   --lex-only    stop after lexing and report the token count
+//   --parse-only  stop after parsing
+//   --emit-each   parse, generate and print one top-level declaration at a
+//                 time, so memory doesn't grow with the input (with --stream);
+//                 the builtins used are declared at the end
+//   --flat-ast    generate code from the flat form of the AST
+//   --fold        fold constants and trivial identities while generating code
+//   --short-circuit  evaluate the rhs of && and || in conditions only when needed
+//   --ssa         keep local variables in SSA form, as mem2reg would
+//   --simplify-cfg  remove unreachable blocks and merge chains of blocks
+//   --remove-dead  remove the functions main doesn't call and the globals they
+//                 don't use, and report how many on stderr; not with --emit-each
+//   --read-ll     read the LLVM IR a.out prints instead of SysY source, and
+//                 run the passes given on it
+//   --write-ir    write an IR file (see ir_file.hpp) instead of text; not with
+//                 --emit-each
+//   --time        report the time of each phase on stderr
+// The input may also be an IR file, which skips the front-end: the passes
+// asked for run on its IR.
+
+// Only one declaration's AST and IR are alive at a time. An error is
+// reported after the code of the declarations before it. LLVM allows the
+// builtins to be declared after their uses.
+static void emit_each(Lexer & lexer, CodegenOptions options, bool simplify) {
+  Codegen codegen{options};
+  while (lexer.peek().tag != Token::ERR) {
+    ast::Program item;
+    item.push_back(parse_global(lexer, item.arena));
+    codegen.add_global(item.front());
+    auto program = codegen.take_ir();
+    if (simplify) foreach_func(program, simplify_cfg);
     foreach_func(program, assign_vregs);
     std::cout << program;
+  }
+  std::cout << std::move(codegen).get();
+}
+
+// runs the passes asked for on `program`, and numbers its values
+static void run_passes(ir::Program & program, bool remove_dead, bool simplify, PhaseTimer & timer) {
+  if (remove_dead) {
+    auto removed = remove_dead_globals(program);
+    timer.lap("remove dead");
+    std::cerr << "removed " << removed.funcs << " functions, " << removed.decls << " declarations, "
+              << removed.vars << " global variables" << std::endl;
+  }
+  if (simplify) {
+    foreach_func(program, simplify_cfg);
+    timer.lap("simplify cfg");
+  }
+  foreach_func(program, assign_vregs);
+}
+
+static void emit(const ir::Program & program, bool write_ir) {
+  if (write_ir) {
+    write_ir_file(std::cout, program);
+  } else {
+    std::cout << program;
+  }
+}
+
+int main(int argc, char * argv[]) {
+  try {
+    bool stream = false;
+    bool lazy_lex = false;
+    bool lex_only = false;
+    bool parse_only = false;
+    bool each = false;
+    bool flat_ast = false;
+    bool simplify = false;
+    bool remove_dead = false;
+    bool read_ll = false;
+    bool write_ir = false;
+    CodegenOptions options;
+    bool time = false;
+    unsigned jobs = 1;
+    const char * path = nullptr;
+    for (int i = 1; i < argc; i++) {
+      const char * arg = argv[i]; // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+      if (std::strcmp(arg, "--stream") == 0) stream = true;
+      else if (std::strcmp(arg, "--lazy-lex") == 0) lazy_lex = true;
+      else if (std::strcmp(arg, "--lex-only") == 0) lex_only = true;
+      else if (std::strcmp(arg, "--parse-only") == 0) parse_only = true;
+      else if (std::strcmp(arg, "--emit-each") == 0) each = true;
+      else if (std::strcmp(arg, "--flat-ast") == 0) flat_ast = true;
+      else if (std::strcmp(arg, "--fold") == 0) options.fold = true;
+      else if (std::strcmp(arg, "--short-circuit") == 0) options.short_circuit = true;
+      else if (std::strcmp(arg, "--ssa") == 0) options.ssa = true;
+      else if (std::strcmp(arg, "--simplify-cfg") == 0) simplify = true;
+      else if (std::strcmp(arg, "--remove-dead") == 0) remove_dead = true;
+      else if (std::strcmp(arg, "--read-ll") == 0) read_ll = true;
+      else if (std::strcmp(arg, "--write-ir") == 0) write_ir = true;
+      else if (std::strcmp(arg, "--time") == 0) time = true;
+      else if (std::strcmp(arg, "--jobs") == 0 && i + 1 < argc) {
+        jobs = unsigned(std::strtoul(argv[++i], nullptr, 10)); // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+        if (jobs == 0) jobs = std::thread::hardware_concurrency();
+      }
+      else if (arg[0] == '-') throw "unknown option";
+      else path = arg;
+    }
+
+    PhaseTimer timer{time};
+    std::ifstream file;
+    std::optional<Source> source;
+    if (stream) {
+      if (path != nullptr) {
+        file.open(path);
+        if (!file) throw "can't open input file";
+      }
+    } else {
+      source.emplace(path != nullptr ? Source::map_file(path) : Source::read_all(std::cin));
+      timer.lap("read", source->size());
+    }
+
+    if (read_ll && !source.has_value()) throw "--read-ll needs the whole input";
+    if (source.has_value() && (read_ll || is_ir_file(source->begin(), source->end()))) {
+      if (each || lex_only || parse_only) throw "the input is already IR";
+      auto program = read_ll
+        ? parse_ir(source->begin(), source->end())
+        : read_ir_file(source->begin(), source->end());
+      timer.lap("read ir", source->size());
+      run_passes(program, remove_dead, simplify, timer);
+      emit(program, write_ir);
+      timer.lap("print");
+      return 0;
+    }
+
+    if (each) {
+      if (remove_dead) throw "--remove-dead needs the whole program";
+      if (write_ir) throw "--write-ir needs the whole program";
+      Lexer lexer = source.has_value()
+        ? Lexer{source->begin(), source->end()}
+        : Lexer{path != nullptr ? file : std::cin};
+      emit_each(lexer, options, simplify);
+      timer.lap("emit each");
+      return 0;
+    }
+
+    ast::Program ast;
+    if (source.has_value() && !lazy_lex) {
+      auto tokens = lex_all(source->begin(), source->end(), jobs);
+      timer.lap("lex", source->size());
+      if (lex_only) {
+        std::cerr << tokens.size() - 1 << " tokens" << std::endl;
+        return 0;
+      }
+      ast = parse(tokens, jobs);
+      timer.lap("parse");
+    } else {
+      Lexer lexer = source.has_value()
+        ? Lexer{source->begin(), source->end()}
+        : Lexer{path != nullptr ? file : std::cin};
+      if (lex_only) {
+        std::size_t count = 0;
+        while (lexer.get().tag != Token::ERR) count++;
+        timer.lap("lex", source.has_value() ? source->size() : 0);
+        std::cerr << count << " tokens" << std::endl;
+        return 0;
+      }
+      ast = parse(lexer);
+      timer.lap("lex+parse", source.has_value() ? source->size() : 0);
+    }
+    if (parse_only) return 0;
+
+    Codegen codegen{options};
+    if (flat_ast) {
+      auto flat = ast::flatten(ast);
+      ast = ast::Program{};
+      timer.lap("flatten");
+      codegen.add_program(flat);
+    } else {
+      codegen.add_program(ast, jobs);
+    }
+    auto program = std::move(codegen).get();
+    timer.lap("codegen");
+    run_passes(program, remove_dead, simplify, timer);
+    // the AST isn't needed for printing
+    ast = ast::Program{};
+    timer.lap("free ast");
+    emit(program, write_ir);
+    timer.lap("print");
   } catch (const char * err) {
     std::cout << err << std::endl;
     return 1;
@@ -22,6 +22,28 @@ AdjList<ir::Label> inverse_cfg(ir::Func & func) {
       },
     }, block.terminator);
   }
+  // a block that can't reach a ret, as in a loop without a break, is made
+  // an end node too, so that every block is visited from nullptr
+  auto & ends = result[nullptr];
+  std::set<ir::Label> reached;
+  std::vector<ir::Label> stack = ends;
+  auto reach = [&result, &reached, &stack]() {
+    while (!stack.empty()) {
+      auto block = stack.back();
+      stack.pop_back();
+      if (reached.insert(block).second) {
+        stack.insert(stack.end(), result.at(block).begin(), result.at(block).end());
+      }
+    }
+  };
+  reach();
+  for (auto & block : func.blocks) {
+    if (!reached.contains(&block)) {
+      ends.push_back(&block);
+      stack.push_back(&block);
+      reach();
+    }
+  }
   return result;
 }
 
@@ -34,15 +56,15 @@ void mem2reg(ir::Func & func, const AdjList<ir::Label> & df) {
     for (auto & instr : block.body) {
       std::visit(overloaded{
         [&var_blocks, &block, &dead](ir::Store & instr) {
-          if (std::holds_alternative<ir::Result>(instr.ptr)) {
-            auto var = &*std::get<ir::Result>(instr.ptr);
+          if (instr.ptr.is<ir::Result>()) {
+            auto var = &*instr.ptr.get<ir::Result>();
             dead.push_back(var);
             var_blocks[var].second.push_back(&block);
           }
         },
         [&var_blocks, &dead](ir::Load & instr) {
-          if (std::holds_alternative<ir::Result>(instr.ptr)) {
-            auto var = &*std::get<ir::Result>(instr.ptr);
+          if (instr.ptr.is<ir::Result>()) {
+            auto var = &*instr.ptr.get<ir::Result>();
             if (std::find(dead.begin(), dead.end(), var) == dead.end()) {
               var_blocks[var].first = true;
             }
@@ -64,8 +86,7 @@ void mem2reg(ir::Func & func, const AdjList<ir::Label> & df) {
           for (auto block : it->second) {
             auto & phi = phi_map[block][var];
             if (phi == ir::InstrRef{}) {
-              block->body.emplace_front(ir::Phi{ir::I32});
-              phi = block->body.begin();
+              phi = block->push_front(ir::Phi{ir::I32});
               todo.push_back(block);
             }
           }
@@ -91,18 +112,15 @@ void mem2reg(ir::Func & func, const AdjList<ir::Label> & df) {
           block->body.erase(it--);
         },
         [&block, &var_values, &it](ir::Store & instr) {
-          if (std::holds_alternative<ir::Result>(instr.ptr)) {
-            var_values.at(&*std::get<ir::Result>(instr.ptr)) = instr.from;
+          if (instr.ptr.is<ir::Result>()) {
+            var_values.at(&*instr.ptr.get<ir::Result>()) = instr.from;
             block->body.erase(it--);
           }
         },
-        [&var_values, &it](ir::Load & instr) {
-          if (std::holds_alternative<ir::Result>(instr.ptr)) {
-            *it = ir::Binary{
-              ir::Binary::ADD, ir::I32,
-              var_values.at(&*std::get<ir::Result>(instr.ptr)),
-              ir::Const{0}
-            };
+        [&block, &var_values, &it](ir::Load & instr) {
+          if (instr.ptr.is<ir::Result>()) {
+            replace_all_uses_with(*it, var_values.at(&*instr.ptr.get<ir::Result>()));
+            erase_if_dead(*block, it--);
           }
         },
         [](auto & _) {},
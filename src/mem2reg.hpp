@@ -3,13 +3,16 @@
 #include <algorithm>
 #include <functional>
 #include <map>
+#include <utility>
+#include <vector>
 
 #include "ir.hpp"
 
 template<typename Node>
 using AdjList = std::map<Node, std::vector<Node>>;
 
-// Calculates the inverse of CFG with nullptr added as an initial node.
+// Calculates the inverse of CFG with nullptr added as an initial node,
+// which every block reaches.
 AdjList<ir::Label> inverse_cfg(ir::Func & func);
 
 template<typename Block>
@@ -39,56 +42,79 @@ std::vector<Block> postorder(const AdjList<Block> & cfg, Block initial) {
 // from the initial block to `block`.
 // Thus, `*++dom_sets[block].rbegin() == IDom(block)`
 // except for the initial block.
+// The blocks are visited in `order`, and any order gives the same sets;
+// one that puts preds first takes the fewest passes. Blocks the initial
+// block doesn't reach have no set.
 template<typename Block>
 AdjList<Block> dominator_sets(
   Block initial,
   const AdjList<Block> & inv_cfg,
   const std::vector<Block> & order
 ) {
-  AdjList<Block> result;
-  result.emplace(initial, std::vector{initial});
+  // number the blocks in postorder from the initial block, so a block's
+  // dominators have larger numbers than it
+  AdjList<Block> cfg;
+  for (auto & [block, preds] : inv_cfg) {
+    for (auto pred : preds) cfg[pred].push_back(block);
+  }
+  std::map<Block, std::size_t> number;
+  std::vector<Block> blocks;
+  std::vector<std::pair<Block, std::size_t>> stack{{initial, 0}};
+  number.emplace(initial, 0);
+  while (!stack.empty()) {
+    auto & [block, next] = stack.back();
+    auto succs = cfg.find(block);
+    if (succs != cfg.end() && next < succs->second.size()) {
+      auto succ = succs->second[next++];
+      if (number.emplace(succ, 0).second) stack.emplace_back(succ, 0);
+    } else {
+      number[block] = blocks.size();
+      blocks.push_back(block);
+      stack.pop_back();
+    }
+  }
+
+  // idom[i] is the number of the immediate dominator of block i found so
+  // far, or none; the initial block is its own
+  constexpr auto none = std::size_t(-1);
+  std::vector<std::size_t> idom(blocks.size(), none);
+  idom.back() = blocks.size() - 1;
   while (true) {
     bool changed = false;
     for (auto block : order) {
-      auto & dom = result[block];
-      bool unset = dom.empty();
-      if (!dom.empty()) {
-        dom.pop_back();
-      }
-      // dom <- ∩_{pred in pred(block)} Dom(pred)
+      auto it = number.find(block);
+      if (it == number.end() || block == initial) continue;
+      // IDom(block) <- the nearest common dominator of the preds done so far
+      auto new_idom = none;
       for (auto pred : inv_cfg.at(block)) {
-        // if pred != {all blocks}
-        if (auto it = result.find(pred); it != result.end()) {
-          auto & dom_pred = it->second;
-          if (unset) {
-            // if dom == {all blocks}, dom <- dom_pred
-            dom = dom_pred;
-            unset = false;
-            changed = true;
-          } else {
-            // otherwise, dom <- dom ∩ dom_pred
-            // find common prefix
-            auto lhs = dom.begin();
-            auto rhs = dom_pred.begin();
-            while (
-              lhs != dom.end() &&
-              rhs != dom_pred.end() &&
-              *lhs == *rhs
-            ) {
-              lhs++; rhs++;
-            }
-            // cut the different part
-            if (lhs != dom.end()) {
-              dom.resize(lhs - dom.begin());
-              changed = true;
-            }
-          }
+        auto pred_it = number.find(pred);
+        if (pred_it == number.end() || idom[pred_it->second] == none) continue;
+        auto runner = pred_it->second;
+        if (new_idom == none) {
+          new_idom = runner;
+          continue;
+        }
+        while (runner != new_idom) {
+          while (runner < new_idom) runner = idom[runner];
+          while (new_idom < runner) new_idom = idom[new_idom];
         }
       }
-      dom.push_back(block); // now dom == Dom(block)
+      if (new_idom != idom[it->second]) {
+        idom[it->second] = new_idom;
+        changed = true;
+      }
     }
     if (!changed) break;
   }
+
+  // a block's path is its idom's with the block added, and idoms come first
+  AdjList<Block> result;
+  for (auto i = blocks.size(); i-- > 0;) {
+    if (idom[i] == none) continue;
+    auto & dom = result[blocks[i]];
+    if (idom[i] != i) dom = result.at(blocks[idom[i]]);
+    dom.push_back(blocks[i]);
+  }
   return result;
 }
 
@@ -1,17 +1,69 @@
+#include <cstring>
 #include <iostream>
 
 #include "parser.hpp"
 #include "codegen.hpp"
+#include "ir_file.hpp"
+#include "ir_parser.hpp"
 #include "mem2reg.hpp"
+#include "remove_dead.hpp"
+#include "simplify_cfg.hpp"
+#include "source.hpp"
+#include "timer.hpp"
 
-int main() {
+// usage: mem2reg [--remove-dead] [--read-ll] [--write-ir] [--time] [file]
+//   --remove-dead  remove the functions main doesn't call and the globals they
+//                 don't use, and report how many on stderr
+//   --read-ll     read the LLVM IR a.out prints instead of SysY source
+//   --write-ir    write an IR file (see ir_file.hpp) instead of text
+//   --time        report the time of each phase on stderr
+// The input may also be an IR file. IR read in either way is used as it is.
+int main(int argc, char * argv[]) {
   try {
-    Lexer lexer{std::cin};
-    auto ast = parse(lexer);
-    Codegen codegen;
-    codegen.add_program(ast);
-    auto program = std::move(codegen).get();
+    bool remove_dead = false;
+    bool read_ll = false;
+    bool write_ir = false;
+    bool time = false;
+    const char * path = nullptr;
+    for (int i = 1; i < argc; i++) {
+      const char * arg = argv[i]; // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+      if (std::strcmp(arg, "--remove-dead") == 0) remove_dead = true;
+      else if (std::strcmp(arg, "--read-ll") == 0) read_ll = true;
+      else if (std::strcmp(arg, "--write-ir") == 0) write_ir = true;
+      else if (std::strcmp(arg, "--time") == 0) time = true;
+      else if (arg[0] == '-') throw "unknown option";
+      else path = arg;
+    }
+    PhaseTimer timer{time};
+    auto source = path != nullptr ? Source::map_file(path) : Source::read_all(std::cin);
+    timer.lap("read", source.size());
+    ir::Program program;
+    if (read_ll) {
+      program = parse_ir(source.begin(), source.end());
+      timer.lap("read ir", source.size());
+    } else if (is_ir_file(source.begin(), source.end())) {
+      program = read_ir_file(source.begin(), source.end());
+      timer.lap("read ir", source.size());
+    } else {
+      Lexer lexer{source.begin(), source.end()};
+      auto ast = parse(lexer);
+      // the passes below work on less IR
+      CodegenOptions options;
+      options.fold = true;
+      options.short_circuit = true;
+      Codegen codegen{options};
+      codegen.add_program(ast);
+      program = std::move(codegen).get();
+      timer.lap("front-end", source.size());
+    }
+    if (remove_dead) {
+      auto removed = remove_dead_globals(program);
+      timer.lap("remove dead");
+      std::cerr << "removed " << removed.funcs << " functions, " << removed.decls << " declarations, "
+                << removed.vars << " global variables" << std::endl;
+    }
     foreach_func(program, [](ir::Func & func) {
+      simplify_cfg(func);
       auto inv_cfg = inverse_cfg(func);
       auto order = postorder(inv_cfg, (ir::Block *)nullptr);
       inv_cfg.erase(nullptr);
@@ -21,7 +73,13 @@ int main() {
       mem2reg(func, df);
       assign_vregs(func);
     });
-    std::cout << program;
+    timer.lap("passes");
+    if (write_ir) {
+      write_ir_file(std::cout, program);
+    } else {
+      std::cout << program;
+    }
+    timer.lap("print");
   } catch (const char * err) {
     std::cout << err << std::endl;
     return 1;
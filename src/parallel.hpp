@@ -0,0 +1,41 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Calls f(i) for every i in [0, count) on up to `jobs` threads,
+// including the calling one. Indices are handed out in order as threads
+// become free. The first exception thrown by f is rethrown here.
+template<typename F>
+void parallel_for(std::size_t count, unsigned jobs, F && f) {
+  std::atomic<std::size_t> next{0};
+  std::exception_ptr error;
+  std::mutex error_mutex;
+  auto work = [&]() {
+    for (auto i = next++; i < count; i = next++) {
+      try {
+        f(i);
+      } catch (...) {
+        std::scoped_lock lock{error_mutex};
+        if (!error) error = std::current_exception();
+        // let the other threads run out of work
+        next = count;
+      }
+    }
+  };
+  std::vector<std::thread> threads;
+  auto thread_count = std::min<std::size_t>(std::max(jobs, 1U), count);
+  for (std::size_t t = 1; t < thread_count; t++) {
+    threads.emplace_back(work);
+  }
+  work();
+  for (auto & thread : threads) {
+    thread.join();
+  }
+  if (error) std::rethrow_exception(error);
+}
@@ -1,192 +1,331 @@
+#include <algorithm>
+
+#include "parallel.hpp"
 #include "parser.hpp"
 
 using namespace ast;
 
-static Global parse_global(Lexer & lexer);
+template<typename Tokens>
+static Global parse_global(Tokens & tokens, Arena & arena);
 
-static Block parse_block(Lexer & lexer);
+template<typename Tokens>
+static Block parse_block(Tokens & tokens, Arena & arena);
 
-static Stmt parse_stmt(Lexer & lexer);
-static Stmt parse_stmt_without_semicolon(Lexer & lexer);
+template<typename Tokens>
+static Stmt parse_stmt(Tokens & tokens, Arena & arena);
+template<typename Tokens>
+static Stmt parse_stmt_without_semicolon(Tokens & tokens, Arena & arena);
 
-static VarDecl parse_var_decl(Lexer & lexer, bool is_const);
-static VarDecl parse_var_decl(Lexer & lexer, bool is_const, Type type);
-static VarDecl parse_var_decl(Lexer & lexer, bool is_const, Type type, Ident && first_name);
+template<typename Tokens>
+static VarDecl parse_var_decl(Tokens & tokens, Arena & arena, bool is_const);
+template<typename Tokens>
+static VarDecl parse_var_decl(Tokens & tokens, Arena & arena, bool is_const, Type type);
+template<typename Tokens>
+static VarDecl parse_var_decl(Tokens & tokens, Arena & arena, bool is_const, Type type, Ident && first_name);
 
-static Expr parse_expr(Lexer & lexer, int prec = 0);
-static Expr parse_expr_beginning_with_ident(Lexer & lexer, Ident && ident, int prec = 0);
-static Expr parse_unary_expr(Lexer & lexer);
-static Expr parse_core_expr(Lexer & lexer);
-static Expr parse_var_or_func_call(Lexer & lexer, Ident && ident);
+// `first` is an identifier the caller has already taken as the start of the expression
+template<typename Tokens>
+static Expr parse_expr(Tokens & tokens, Arena & arena, std::optional<Ident> first = {});
 
-static Type parse_type(Lexer & lexer);
+template<typename Tokens>
+static Type parse_type(Tokens & tokens);
 
 // NOLINTBEGIN(cppcoreguidelines-pro-type-union-access)
 
+template<typename Tokens>
+static Program parse_program(Tokens & tokens) {
+  Program program;
+  while (tokens.peek().tag != Token::ERR) {
+    program.push_back(parse_global(tokens, program.arena));
+  }
+  return program;
+}
+
 Program parse(Lexer & lexer) {
+  return parse_program(lexer);
+}
+
+std::vector<std::size_t> find_globals(const TokenArray & tokens) {
+  std::vector<std::size_t> starts;
+  std::size_t last = tokens.size() - 1;
+  std::size_t depth = 0;
+  bool in_global = false;
+  for (std::size_t i = 0; i < last; i++) {
+    if (!in_global) {
+      starts.push_back(i);
+      in_global = true;
+    }
+    switch (tokens.tags[i]) {
+    case Token::LBRACE:
+      depth++;
+      break;
+    case Token::RBRACE:
+      if (depth > 0 && --depth == 0) in_global = false;
+      break;
+    case Token::SEMICOLON:
+      if (depth == 0) in_global = false;
+      break;
+    default:
+      break;
+    }
+  }
+  starts.push_back(last);
+  return starts;
+}
+
+Global parse_global(TokenCursor & cursor, Arena & arena) {
+  return parse_global<TokenCursor>(cursor, arena);
+}
+
+Global parse_global(Lexer & lexer, Arena & arena) {
+  return parse_global<Lexer>(lexer, arena);
+}
+
+// consecutive top-level declarations parsed by one thread
+struct Batch {
+  // indices into the result of find_globals
+  std::size_t first;
+  std::size_t last;
+  Arena arena;
+  // whether each declaration ended right where the next one was found
+  bool confirmed;
+};
+
+Program parse(const TokenArray & tokens, unsigned jobs) {
+  // below this many tokens per batch, a thread costs more than it saves
+  constexpr std::size_t min_batch = std::size_t(1) << 14;
+  // more batches than threads, since functions differ in size
+  constexpr std::size_t batches_per_job = 4;
+  TokenCursor cursor{tokens};
+  auto batch_count = std::min<std::size_t>(std::size_t(jobs) * batches_per_job, tokens.size() / min_batch);
+  if (jobs <= 1 || batch_count <= 1) {
+    return parse_program(cursor);
+  }
+
+  auto starts = find_globals(tokens);
+  auto global_count = starts.size() - 1;
+  std::vector<Batch> batches;
+  std::size_t first = 0;
+  for (std::size_t i = 1; i <= global_count; i++) {
+    if (i == global_count || starts[i] - starts[first] >= tokens.size() / batch_count) {
+      batches.push_back(Batch{first, i, {}, false});
+      first = i;
+    }
+  }
+
   Program program;
-  while (lexer.peek().tag != Token::ERR) {
-    program.push_back(parse_global(lexer));
+  program.resize(global_count);
+  parallel_for(batches.size(), jobs, [&](std::size_t b) {
+    auto & batch = batches[b];
+    TokenCursor cursor{tokens, starts[batch.first]};
+    try {
+      for (std::size_t i = batch.first; i < batch.last; i++) {
+        program[i] = parse_global(cursor, batch.arena);
+        if (cursor.position() != starts[i + 1]) return;
+      }
+    } catch (const char *) {
+      // reported by the serial parse below
+      return;
+    }
+    batch.confirmed = true;
+  });
+
+  // the exact error, or the result of a wrong guess, comes from a serial parse
+  for (auto & batch : batches) {
+    if (!batch.confirmed) return parse_program(cursor);
+  }
+  for (auto & batch : batches) {
+    program.arena.adopt(std::move(batch.arena));
   }
   return program;
 }
 
-Global parse_global(Lexer & lexer) {
-  switch (lexer.peek().tag) {
+template<typename Tokens>
+Global parse_global(Tokens & tokens, Arena & arena) {
+  switch (tokens.peek().tag) {
   case Token::CONST:
   {
-    lexer.get();
-    VarDecl result = parse_var_decl(lexer, true);
-    if (lexer.get().tag != Token::SEMICOLON) throw "expected ';'";
+    tokens.get();
+    VarDecl result = parse_var_decl(tokens, arena, true);
+    if (tokens.get().tag != Token::SEMICOLON) throw "expected ';'";
     return result;
   }
   default:
-    Type type = parse_type(lexer);
-    Ident name = lexer.get().ident;
+    Type type = parse_type(tokens);
+    Ident name = tokens.get().ident;
     if (type == Type::VOID) {
-      if (lexer.get().tag != Token::LPAR) throw "expected '('";
-    } else if (lexer.peek().tag == Token::LPAR) {
-      lexer.get();
+      if (tokens.get().tag != Token::LPAR) throw "expected '('";
+    } else if (tokens.peek().tag == Token::LPAR) {
+      tokens.get();
     } else { // is var
-      VarDecl result = parse_var_decl(lexer, false, type, std::move(name));
-      if (lexer.get().tag != Token::SEMICOLON) throw "expected ';'";
+      VarDecl result = parse_var_decl(tokens, arena, false, type, std::move(name));
+      if (tokens.get().tag != Token::SEMICOLON) throw "expected ';'";
       return result;
     }
     std::vector<ArgDef> args;
-    if (lexer.peek().tag != Token::RPAR) {
+    if (tokens.peek().tag != Token::RPAR) {
       while (true) {
-        Type type = parse_type(lexer);
-        if (lexer.peek().tag != Token::IDENT) throw "expected identifier";
-        args.push_back(ArgDef{type, lexer.get().ident});
-        if (lexer.peek().tag != Token::COMMA) break;
-        lexer.get();
+        Type type = parse_type(tokens);
+        if (tokens.peek().tag != Token::IDENT) throw "expected identifier";
+        args.push_back(ArgDef{type, tokens.get().ident});
+        if (tokens.peek().tag != Token::COMMA) break;
+        tokens.get();
       }
-      if (lexer.peek().tag != Token::RPAR) throw "expected ')'";
+      if (tokens.peek().tag != Token::RPAR) throw "expected ')'";
     }
-    lexer.get();
-    return Func{type, std::move(name), args, parse_block(lexer)};
+    tokens.get();
+    return Func{type, std::move(name), arena.make_array(args), parse_block(tokens, arena)};
   }
 }
 
-Block parse_block(Lexer & lexer) {
-  Token tok = lexer.get();
-  if (tok.tag != Token::LBRACE) throw "expected '{'";
-  Block body;
-  while (lexer.peek().tag != Token::RBRACE) {
-    body.push_back(parse_stmt(lexer));
-  }
-  tok = lexer.get();
-  return body;
+template<typename Tokens>
+Block parse_block(Tokens & tokens, Arena & arena) {
+  if (tokens.peek().tag != Token::LBRACE) throw "expected '{'";
+  return std::get<Block>(parse_stmt(tokens, arena));
 }
 
-Stmt parse_stmt(Lexer & lexer) {
-  switch (lexer.peek().tag) {
-  case Token::SEMICOLON:
-    lexer.get();
-    return std::monostate{};
-  case Token::IF:
-  {
-    lexer.get();
-    if (lexer.get().tag != Token::LPAR) throw "expected '('";
-    Expr cond = parse_expr(lexer);
-    if (lexer.get().tag != Token::RPAR) throw "expected ')'";
-    Stmt true_body = parse_stmt(lexer);
-    if (lexer.peek().tag == Token::ELSE) {
-      lexer.get();
-      Stmt false_body = parse_stmt(lexer);
-      return IfElse{
-        std::move(cond),
-        std::make_unique<Stmt>(std::move(true_body)),
-        std::make_unique<Stmt>(std::move(false_body))
-      };
-    } else {
-      return If{
-        std::move(cond),
-        std::make_unique<Stmt>(std::move(true_body))
-      };
+// a statement whose body is still being parsed
+struct StmtFrame {
+  enum Kind {
+    IF, // waiting for the true body
+    ELSE, // waiting for the false body
+    WHILE,
+    BLOCK
+  } kind;
+  Expr cond;
+  const Stmt * true_body;
+  // first statement of the block in `items`
+  std::size_t base;
+};
+
+// Nested statements are kept on explicit stacks rather than the native one,
+// so any depth of blocks, loops and `else if` chains can be parsed.
+template<typename Tokens>
+Stmt parse_stmt(Tokens & tokens, Arena & arena) {
+  std::vector<StmtFrame> frames;
+  // statements of all open blocks, innermost last
+  std::vector<Stmt> items;
+  while (true) {
+    Stmt stmt;
+    switch (tokens.peek().tag) {
+    case Token::IF:
+    case Token::WHILE:
+    {
+      auto kind = tokens.get().tag == Token::IF ? StmtFrame::IF : StmtFrame::WHILE;
+      if (tokens.get().tag != Token::LPAR) throw "expected '('";
+      Expr cond = parse_expr(tokens, arena);
+      if (tokens.get().tag != Token::RPAR) throw "expected ')'";
+      frames.push_back(StmtFrame{kind, cond, nullptr, 0});
+      continue;
     }
-  }
-  case Token::WHILE:
-  {
-    lexer.get();
-    if (lexer.get().tag != Token::LPAR) throw "expected '('";
-    Expr cond = parse_expr(lexer);
-    if (lexer.get().tag != Token::RPAR) throw "expected ')'";
-    Stmt body = parse_stmt(lexer);
-    return While{
-      std::move(cond),
-      std::make_unique<Stmt>(std::move(body))
-    };
-  }
-  case Token::LBRACE:
-    return parse_block(lexer);
-  default:
-    Stmt stmt = parse_stmt_without_semicolon(lexer);
-    if (lexer.get().tag != Token::SEMICOLON) {
-      throw "expected ';'";
+    case Token::LBRACE:
+      tokens.get();
+      if (tokens.peek().tag != Token::RBRACE) {
+        frames.push_back(StmtFrame{StmtFrame::BLOCK, {}, nullptr, items.size()});
+        continue;
+      }
+      tokens.get();
+      stmt = Block{};
+      break;
+    case Token::SEMICOLON:
+      tokens.get();
+      break;
+    default:
+      stmt = parse_stmt_without_semicolon(tokens, arena);
+      if (tokens.get().tag != Token::SEMICOLON) {
+        throw "expected ';'";
+      }
     }
-    return stmt;
+
+    // `stmt` is complete; finish the statements it completes in turn
+    while (!frames.empty()) {
+      StmtFrame & frame = frames.back();
+      if (frame.kind == StmtFrame::BLOCK) {
+        items.push_back(stmt);
+        if (tokens.peek().tag != Token::RBRACE) break;
+        tokens.get();
+        stmt = Block{arena.make_array(std::span(items).subspan(frame.base))};
+        items.resize(frame.base);
+      } else if (frame.kind == StmtFrame::IF && tokens.peek().tag == Token::ELSE) {
+        tokens.get();
+        frame.kind = StmtFrame::ELSE;
+        frame.true_body = arena.make<Stmt>(stmt);
+        break;
+      } else if (frame.kind == StmtFrame::IF) {
+        stmt = If{frame.cond, arena.make<Stmt>(stmt)};
+      } else if (frame.kind == StmtFrame::ELSE) {
+        stmt = IfElse{frame.cond, frame.true_body, arena.make<Stmt>(stmt)};
+      } else {
+        stmt = While{frame.cond, arena.make<Stmt>(stmt)};
+      }
+      frames.pop_back();
+    }
+    if (frames.empty()) return stmt;
   }
 }
 
-Stmt parse_stmt_without_semicolon(Lexer & lexer) {
-  switch (lexer.peek().tag) {
+template<typename Tokens>
+Stmt parse_stmt_without_semicolon(Tokens & tokens, Arena & arena) {
+  switch (tokens.peek().tag) {
   case Token::RETURN: // return
-    lexer.get();
-    if (lexer.peek().tag == Token::SEMICOLON) return Return{{}};
-    else return Return{parse_expr(lexer)};
+    tokens.get();
+    if (tokens.peek().tag == Token::SEMICOLON) return Return{{}};
+    else return Return{parse_expr(tokens, arena)};
   case Token::BREAK:
-    lexer.get();
+    tokens.get();
     return Break{};
   case Token::CONTINUE:
-    lexer.get();
+    tokens.get();
     return Continue{};
   case Token::IDENT: // assign or expr
   {
-    Ident ident = lexer.get().ident;
-    switch (lexer.peek().tag) {
+    Ident ident = tokens.get().ident;
+    switch (tokens.peek().tag) {
       case Token::ASSIGN: //assign
-        lexer.get();
-        return Assign{std::move(ident), parse_expr(lexer)};
+        tokens.get();
+        return Assign{std::move(ident), parse_expr(tokens, arena)};
       default: // expr
-        return parse_expr_beginning_with_ident(lexer, std::move(ident));
+        return parse_expr(tokens, arena, ident);
     }
   }
   case Token::CONST: // decl
-    lexer.get();
-    return parse_var_decl(lexer, true);
+    tokens.get();
+    return parse_var_decl(tokens, arena, true);
   case Token::INT:
-    return parse_var_decl(lexer, false);
+    return parse_var_decl(tokens, arena, false);
   default: // expr
-    return parse_expr(lexer);
+    return parse_expr(tokens, arena);
   }
 }
 
-VarDecl parse_var_decl(Lexer & lexer, bool is_const) {
-  return parse_var_decl(lexer, is_const, parse_type(lexer));
+template<typename Tokens>
+VarDecl parse_var_decl(Tokens & tokens, Arena & arena, bool is_const) {
+  return parse_var_decl(tokens, arena, is_const, parse_type(tokens));
 }
 
-VarDecl parse_var_decl(Lexer & lexer, bool is_const, Type type) {
-  if (lexer.peek().tag != Token::IDENT) throw "expected identifier";
-  return parse_var_decl(lexer, is_const, type, lexer.get().ident);
+template<typename Tokens>
+VarDecl parse_var_decl(Tokens & tokens, Arena & arena, bool is_const, Type type) {
+  if (tokens.peek().tag != Token::IDENT) throw "expected identifier";
+  return parse_var_decl(tokens, arena, is_const, type, tokens.get().ident);
 }
 
-VarDecl parse_var_decl(Lexer & lexer, bool is_const, Type type, Ident && name) {
+template<typename Tokens>
+VarDecl parse_var_decl(Tokens & tokens, Arena & arena, bool is_const, Type type, Ident && name) {
   std::vector<VarDef> defs;
   while (true) {
-    if (lexer.peek().tag == Token::ASSIGN) {
-      lexer.get();
-      defs.push_back(VarDef{name, parse_expr(lexer)});
+    if (tokens.peek().tag == Token::ASSIGN) {
+      tokens.get();
+      defs.push_back(VarDef{name, parse_expr(tokens, arena)});
     } else {
       if (is_const) throw "expected '='";
       defs.push_back(VarDef{name, {}});
     }
-    if (lexer.peek().tag != Token::COMMA) break;
-    lexer.get();
-    if (lexer.peek().tag != Token::IDENT) throw "expected identifier";
-    name = lexer.get().ident;
+    if (tokens.peek().tag != Token::COMMA) break;
+    tokens.get();
+    if (tokens.peek().tag != Token::IDENT) throw "expected identifier";
+    name = tokens.get().ident;
   }
-  return VarDecl{is_const, type, std::move(defs)};
+  return VarDecl{is_const, type, arena.make_array(defs)};
 }
 
 // for binary op, returns precedence; for others, returns 0
@@ -237,34 +376,6 @@ static constexpr Binary::Op tok_to_binary(Token::Tag op) {
   }
 }
 
-Expr parse_expr(Lexer & lexer, int prev_prec) {
-  Expr lhs = parse_unary_expr(lexer);
-  while (prec(lexer.peek().tag) > prev_prec) {
-    Token tok = lexer.get();
-    Expr rhs = parse_expr(lexer, prec(tok.tag));
-    lhs = Binary{
-      tok_to_binary(tok.tag),
-      std::make_unique<Expr>(std::move(lhs)),
-      std::make_unique<Expr>(std::move(rhs))
-    };
-  }
-  return lhs;
-}
-
-Expr parse_expr_beginning_with_ident(Lexer & lexer, Ident && ident, int prev_prec) {
-  Expr lhs = parse_var_or_func_call(lexer, std::move(ident));
-  while (prec(lexer.peek().tag) > prev_prec) {
-    Token tok = lexer.get();
-    Expr rhs = parse_expr(lexer, prec(tok.tag));
-    lhs = Binary{
-      tok_to_binary(tok.tag),
-      std::make_unique<Expr>(std::move(lhs)),
-      std::make_unique<Expr>(std::move(rhs))
-    };
-  }
-  return lhs;
-}
-
 static constexpr bool is_unary(Token::Tag op) {
   switch (op) {
   case Token::PLUS:
@@ -285,67 +396,108 @@ static constexpr Unary::Op tok_to_unary(Token::Tag op) {
   }
 }
 
-Expr parse_unary_expr(Lexer & lexer) {
-  std::vector<Token> stack;
-  while (is_unary(lexer.peek().tag)) {
-    stack.push_back(lexer.get());
-  }
-  Expr expr = parse_core_expr(lexer);
-  while (!stack.empty()) {
-    expr = Unary{
-      tok_to_unary(stack.back().tag),
-      std::make_unique<Expr>(std::move(expr))
-    };
-    stack.pop_back();
-  }
-  return expr;
-}
+// an operator or bracket waiting for the rest of its operands
+struct ExprFrame {
+  enum Kind {
+    UNARY, BINARY, PAREN, CALL
+  } kind;
+  Token::Tag op;
+  Ident func;
+  // first argument of the call in `operands`
+  std::size_t base;
+};
 
-Expr parse_core_expr(Lexer & lexer) {
-  Token tok = lexer.get();
-  switch (tok.tag) {
-  case Token::NUMBER:
-    return tok.number;
-  case Token::LPAR:
-  {
-    Expr inner = parse_expr(lexer);
-    tok = lexer.get();
-    if (tok.tag == Token::RPAR) {
-      return inner;
+// Shunting-yard over explicit operator and operand stacks,
+// so any depth of parentheses, operators and calls can be parsed.
+// Binary operators are left associative; prefix operators bind tightest.
+template<typename Tokens>
+Expr parse_expr(Tokens & tokens, Arena & arena, std::optional<Ident> first) {
+  // reused between calls; an expression never contains a statement
+  thread_local std::vector<ExprFrame> frames;
+  thread_local std::vector<Expr> operands;
+  frames.clear();
+  operands.clear();
+
+  // applies the operator on top of `frames` to its operands
+  auto reduce = [&]() {
+    ExprFrame frame = frames.back();
+    frames.pop_back();
+    const Expr * operand = arena.make<Expr>(operands.back());
+    if (frame.kind == ExprFrame::UNARY) {
+      operands.back() = Unary{tok_to_unary(frame.op), operand};
     } else {
-      throw "expected ')'";
+      operands.pop_back();
+      const Expr * lhs = arena.make<Expr>(operands.back());
+      operands.back() = Binary{tok_to_binary(frame.op), lhs, operand};
     }
-  }
-  case Token::IDENT:
-    return parse_var_or_func_call(lexer, std::move(tok.ident));
-  default:
-    throw "expected expr";
-  }
-}
+  };
 
-Expr parse_var_or_func_call(Lexer & lexer, Ident && ident) {
-  if (lexer.peek().tag == Token::LPAR) {
-    lexer.get();
-    if (lexer.peek().tag == Token::RPAR) {
-      lexer.get();
-      return FuncCall{ident, {}};
-    } else {
-      std::vector<Expr> args;
-      while (true) {
-        args.push_back(parse_expr(lexer));
-        if (lexer.peek().tag != Token::COMMA) break;
-        lexer.get();
+  while (true) {
+    // an operand with its prefix operators
+    Token tok = first.has_value() ? Token{*first} : tokens.get();
+    first.reset();
+    if (is_unary(tok.tag)) {
+      frames.push_back(ExprFrame{ExprFrame::UNARY, tok.tag, {}, 0});
+      continue;
+    }
+    switch (tok.tag) {
+    case Token::NUMBER:
+      operands.push_back(tok.number);
+      break;
+    case Token::LPAR:
+      frames.push_back(ExprFrame{ExprFrame::PAREN, tok.tag, {}, 0});
+      continue;
+    case Token::IDENT:
+      if (tokens.peek().tag != Token::LPAR) {
+        operands.push_back(tok.ident);
+        break;
+      }
+      tokens.get();
+      if (tokens.peek().tag != Token::RPAR) {
+        frames.push_back(ExprFrame{ExprFrame::CALL, tok.tag, tok.ident, operands.size()});
+        continue;
+      }
+      tokens.get();
+      operands.push_back(FuncCall{tok.ident, {}});
+      break;
+    default:
+      throw "expected expr";
+    }
+
+    // what follows a complete operand: a binary operator,
+    // or the end of a parenthesis, an argument or the whole expression
+    while (true) {
+      while (!frames.empty() && frames.back().kind == ExprFrame::UNARY) reduce();
+      Token::Tag tag = tokens.peek().tag;
+      if (prec(tag) > 0) {
+        while (
+          !frames.empty() && frames.back().kind == ExprFrame::BINARY &&
+          prec(frames.back().op) >= prec(tag)
+        ) reduce();
+        frames.push_back(ExprFrame{ExprFrame::BINARY, tokens.get().tag, {}, 0});
+        break;
+      }
+      while (!frames.empty() && frames.back().kind == ExprFrame::BINARY) reduce();
+      if (frames.empty()) return operands.back();
+      if (frames.back().kind == ExprFrame::CALL && tag == Token::COMMA) {
+        tokens.get();
+        break;
+      }
+      if (tokens.get().tag != Token::RPAR) throw "expected ')'";
+      ExprFrame frame = frames.back();
+      frames.pop_back();
+      if (frame.kind == ExprFrame::CALL) {
+        auto args = arena.make_array(std::span(operands).subspan(frame.base));
+        operands.resize(frame.base);
+        operands.push_back(FuncCall{frame.func, args});
       }
-      if (lexer.get().tag != Token::RPAR) throw "expected ')'";
-      return FuncCall{ident, std::move(args)};
     }
-  } else {
-    return ident;
   }
 }
 
-Type parse_type(Lexer & lexer) {
-  switch (lexer.get().tag) {
+template<typename Tokens>
+Type parse_type(Tokens & tokens) {
+  switch (tokens.get().tag) {
   case Token::INT: return Type::INT;
   case Token::VOID: return Type::VOID;
   default: throw "expected 'int' or 'void'";
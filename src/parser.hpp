@@ -1,4 +1,17 @@
+#pragma once
+
 #include "lexer.hpp"
 #include "ast.hpp"
 
 ast::Program parse(Lexer & lexer);
+// with jobs > 1, the top-level declarations of large inputs are parsed on
+// that many threads; the result is the same as parsing serially
+ast::Program parse(const TokenArray & tokens, unsigned jobs = 1);
+
+// Token index where each top-level declaration starts, by brace matching,
+// followed by the index of the final ERR. For malformed input this is only
+// a guess, which parsing then fails to confirm.
+std::vector<std::size_t> find_globals(const TokenArray & tokens);
+// parses the top-level declaration at `cursor`, allocating from `arena`
+ast::Global parse_global(TokenCursor & cursor, Arena & arena);
+ast::Global parse_global(Lexer & lexer, Arena & arena);
@@ -0,0 +1,51 @@
+#include <algorithm>
+
+#include "call_graph.hpp"
+#include "overloaded.hpp"
+#include "remove_dead.hpp"
+
+RemovedGlobals remove_dead_globals(ir::Program & program) {
+  auto main = intern("main");
+  bool has_main = std::ranges::any_of(program, [main](const ir::GlobalDef & def) {
+    auto func = std::get_if<ir::Func>(&def);
+    return func != nullptr && func->name == main;
+  });
+  if (!has_main) return {};
+
+  auto live = CallGraph{program}.reachable_from(main);
+  // the globals the live functions load, store or call
+  std::unordered_set<Sym> used;
+  for (auto & def : program) {
+    auto func = std::get_if<ir::Func>(&def);
+    if (func == nullptr || !live.contains(func->name)) continue;
+    for (auto & block : func->blocks) {
+      for (auto & instr : block.body) {
+        foreach_operand(instr, [&used](const ir::Operand & operand) {
+          if (auto global = operand.get_if<ir::Global>()) used.insert(*global);
+        });
+      }
+    }
+  }
+
+  RemovedGlobals removed;
+  std::erase_if(program, [&live, &used, &removed](const ir::GlobalDef & def) {
+    return std::visit(overloaded {
+      [&live, &removed](const ir::Func & func) {
+        bool dead = !live.contains(func.name);
+        removed.funcs += dead ? 1 : 0;
+        return dead;
+      },
+      [&used, &removed](const ir::FuncDecl & decl) {
+        bool dead = !used.contains(decl.name);
+        removed.decls += dead ? 1 : 0;
+        return dead;
+      },
+      [&used, &removed](const ir::GlobalVar & var) {
+        bool dead = !used.contains(var.name);
+        removed.vars += dead ? 1 : 0;
+        return dead;
+      },
+    }, def);
+  });
+  return removed;
+}
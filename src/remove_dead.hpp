@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+
+#include "ir.hpp"
+
+struct RemovedGlobals {
+  std::size_t funcs = 0;
+  std::size_t decls = 0;
+  std::size_t vars = 0;
+};
+
+// Removes the functions main can't call, and the declarations and global
+// variables that no remaining function uses. A program without main is
+// left as it is.
+RemovedGlobals remove_dead_globals(ir::Program & program);
@@ -0,0 +1,169 @@
+#include "scan.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+// NOLINTBEGIN(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+// NOLINTBEGIN(cppcoreguidelines-pro-type-reinterpret-cast)
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers)
+
+// scalar
+
+static inline bool is_space(char c) {
+  return c == ' ' || c == '\r' || c == '\n' || c == '\t';
+}
+
+static const char * skip_space_scalar(const char * p, const char * end) {
+  while (p != end && is_space(*p)) p++;
+  return p;
+}
+
+static const char * find_newline_scalar(const char * p, const char * end) {
+  while (p != end && *p != '\n') p++;
+  return p;
+}
+
+static const char * find_comment_end_scalar(const char * p, const char * end) {
+  for (; end - p >= 2; p++) {
+    if (p[0] == '*' && p[1] == '/') return p;
+  }
+  return end;
+}
+
+#ifdef SCAN_X86
+
+// SSE2, 16 bytes at a time
+
+static const char * skip_space_sse2(const char * p, const char * end) {
+  const __m128i space = _mm_set1_epi8(' ');
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i lf = _mm_set1_epi8('\n');
+  const __m128i tab = _mm_set1_epi8('\t');
+  for (; end - p >= 16; p += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i spaces = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(chunk, space), _mm_cmpeq_epi8(chunk, cr)),
+      _mm_or_si128(_mm_cmpeq_epi8(chunk, lf), _mm_cmpeq_epi8(chunk, tab))
+    );
+    auto others = ~unsigned(_mm_movemask_epi8(spaces)) & 0xFFFFU;
+    if (others != 0) return p + __builtin_ctz(others);
+  }
+  return skip_space_scalar(p, end);
+}
+
+static const char * find_newline_sse2(const char * p, const char * end) {
+  const __m128i lf = _mm_set1_epi8('\n');
+  for (; end - p >= 16; p += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    auto found = unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, lf)));
+    if (found != 0) return p + __builtin_ctz(found);
+  }
+  return find_newline_scalar(p, end);
+}
+
+static const char * find_comment_end_sse2(const char * p, const char * end) {
+  const __m128i star = _mm_set1_epi8('*');
+  const __m128i slash = _mm_set1_epi8('/');
+  // each round also reads the byte after the chunk
+  for (; end - p >= 17; p += 16) {
+    __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 1));
+    auto found = unsigned(_mm_movemask_epi8(_mm_and_si128(
+      _mm_cmpeq_epi8(first, star),
+      _mm_cmpeq_epi8(second, slash)
+    )));
+    if (found != 0) return p + __builtin_ctz(found);
+  }
+  return find_comment_end_scalar(p, end);
+}
+
+// AVX2, 32 bytes at a time
+
+__attribute__((target("avx2")))
+static const char * skip_space_avx2(const char * p, const char * end) {
+  const __m256i space = _mm256_set1_epi8(' ');
+  const __m256i cr = _mm256_set1_epi8('\r');
+  const __m256i lf = _mm256_set1_epi8('\n');
+  const __m256i tab = _mm256_set1_epi8('\t');
+  for (; end - p >= 32; p += 32) {
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i spaces = _mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(chunk, space), _mm256_cmpeq_epi8(chunk, cr)),
+      _mm256_or_si256(_mm256_cmpeq_epi8(chunk, lf), _mm256_cmpeq_epi8(chunk, tab))
+    );
+    auto others = ~unsigned(_mm256_movemask_epi8(spaces));
+    if (others != 0) return p + __builtin_ctz(others);
+  }
+  return skip_space_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char * find_newline_avx2(const char * p, const char * end) {
+  const __m256i lf = _mm256_set1_epi8('\n');
+  for (; end - p >= 32; p += 32) {
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    auto found = unsigned(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, lf)));
+    if (found != 0) return p + __builtin_ctz(found);
+  }
+  return find_newline_sse2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char * find_comment_end_avx2(const char * p, const char * end) {
+  const __m256i star = _mm256_set1_epi8('*');
+  const __m256i slash = _mm256_set1_epi8('/');
+  for (; end - p >= 33; p += 32) {
+    __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 1));
+    auto found = unsigned(_mm256_movemask_epi8(_mm256_and_si256(
+      _mm256_cmpeq_epi8(first, star),
+      _mm256_cmpeq_epi8(second, slash)
+    )));
+    if (found != 0) return p + __builtin_ctz(found);
+  }
+  return find_comment_end_sse2(p, end);
+}
+
+#endif
+
+// dispatch
+
+struct Scanners {
+  const char * (*skip_space)(const char *, const char *);
+  const char * (*find_newline)(const char *, const char *);
+  const char * (*find_comment_end)(const char *, const char *);
+};
+
+static Scanners select_scanners() {
+#ifdef SCAN_X86
+  // we may run before the CPU model is initialized by its own constructor
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return {skip_space_avx2, find_newline_avx2, find_comment_end_avx2};
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return {skip_space_sse2, find_newline_sse2, find_comment_end_sse2};
+  }
+#endif
+  return {skip_space_scalar, find_newline_scalar, find_comment_end_scalar};
+}
+
+static const Scanners scanners = select_scanners();
+
+const char * skip_space(const char * begin, const char * end) {
+  return scanners.skip_space(begin, end);
+}
+
+const char * find_newline(const char * begin, const char * end) {
+  return scanners.find_newline(begin, end);
+}
+
+const char * find_comment_end(const char * begin, const char * end) {
+  return scanners.find_comment_end(begin, end);
+}
+
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers)
+// NOLINTEND(cppcoreguidelines-pro-type-reinterpret-cast)
+// NOLINTEND(cppcoreguidelines-pro-bounds-pointer-arithmetic)
@@ -0,0 +1,13 @@
+#pragma once
+
+// Bulk scanners over [begin, end) used by the lexer to skip trivia.
+// They use AVX2 or SSE2 when the CPU has them, and fall back to scalar loops.
+
+// first character that isn't a space, or `end`
+const char * skip_space(const char * begin, const char * end);
+
+// first '\n', or `end`
+const char * find_newline(const char * begin, const char * end);
+
+// the '*' of the first "*/", or `end`
+const char * find_comment_end(const char * begin, const char * end);
@@ -0,0 +1,93 @@
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "document.hpp"
+#include "source.hpp"
+#include "timer.hpp"
+
+// usage: server [--time] [file]
+//
+// Keeps `file`, or an empty text, compiled while an editor changes it.
+// Commands are read from stdin, one per line:
+//   edit OFFSET LENGTH SIZE  replace LENGTH bytes at byte OFFSET by the
+//                            SIZE bytes following the line
+//   ir                       print what a.out would print for the text
+//   quit
+// The initial text and every edit are answered with one line of
+// diagnostics: `ok`, or the error a.out would report.
+//   --time  report the time of each command on stderr
+static void report(const char * err) {
+  std::cout << (err != nullptr ? err : "ok") << std::endl;
+}
+
+int main(int argc, char * argv[]) {
+  try {
+    bool time = false;
+    const char * path = nullptr;
+    for (int i = 1; i < argc; i++) {
+      const char * arg = argv[i]; // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+      if (std::strcmp(arg, "--time") == 0) time = true;
+      else if (arg[0] == '-') throw "unknown option";
+      else path = arg;
+    }
+
+    PhaseTimer timer{time};
+    std::string text;
+    if (path != nullptr) {
+      auto source = Source::map_file(path);
+      text.assign(source.begin(), source.end());
+    }
+    Document document{std::move(text)};
+    report(document.diagnose());
+    timer.lap("open");
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+      std::istringstream words{line};
+      std::string command;
+      words >> command;
+      if (command == "edit") {
+        std::size_t offset = 0;
+        std::size_t length = 0;
+        std::size_t size = 0;
+        if (!(words >> offset >> length >> size)) {
+          report("bad edit command");
+          continue;
+        }
+        std::string replacement(size, '\0');
+        if (!std::cin.read(replacement.data(), std::streamsize(size))) {
+          throw "unexpected end of input";
+        }
+        PhaseTimer edit_timer{time};
+        try {
+          document.edit(offset, length, replacement);
+        } catch (const char * err) {
+          report(err);
+          continue;
+        }
+        report(document.diagnose());
+        edit_timer.lap("edit");
+      } else if (command == "ir") {
+        PhaseTimer ir_timer{time};
+        try {
+          document.print(std::cout);
+        } catch (const char * err) {
+          // like a.out, after what was printed so far
+          report(err);
+        }
+        std::cout.flush();
+        ir_timer.lap("ir");
+      } else if (command == "quit") {
+        break;
+      } else {
+        report("unknown command");
+      }
+    }
+  } catch (const char * err) {
+    std::cout << err << std::endl;
+    return 1;
+  }
+  return 0;
+}
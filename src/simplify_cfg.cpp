@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "simplify_cfg.hpp"
+
+namespace {
+
+// the blocks each block is branched to from, once per edge
+using Preds = std::unordered_map<ir::Label, std::vector<ir::Label>>;
+
+struct Simplifier {
+  ir::Func & func;
+  Preds preds;
+  std::unordered_set<ir::Label> removed;
+
+  void remove_unreachable();
+  bool skip_forwarding();
+  bool merge_chains();
+  void drop_phis(ir::Block & block);
+
+  // calls `f` on the phis at the start of `block`
+  template<typename F>
+  static void foreach_phi(ir::Block & block, F f) {
+    for (auto & instr : block.body) {
+      auto phi = std::get_if<ir::Phi>(&instr);
+      if (phi == nullptr) break;
+      f(*phi);
+    }
+  }
+  static bool has_phis(const ir::Block & block) {
+    return !block.body.empty() && std::holds_alternative<ir::Phi>(block.body.front());
+  }
+};
+
+}
+
+void Simplifier::remove_unreachable() {
+  auto entry = &this->func.blocks.front();
+  std::unordered_set<ir::Label> reached{entry};
+  std::vector<ir::Label> stack{entry};
+  while (!stack.empty()) {
+    auto block = stack.back();
+    stack.pop_back();
+    foreach_target(block->terminator, [&reached, &stack](ir::Label target) {
+      if (reached.insert(target).second) stack.push_back(target);
+    });
+  }
+
+  for (auto & block : this->func.blocks) {
+    if (!reached.contains(&block)) continue;
+    foreach_phi(block, [&reached](ir::Phi & phi) {
+      std::erase_if(phi.sources, [&reached](const auto & source) { return !reached.contains(source.second); });
+    });
+    foreach_target(block.terminator, [this, &block](ir::Label target) {
+      this->preds[target].push_back(&block);
+    });
+  }
+  this->func.blocks.remove_if([&reached](ir::Block & block) { return !reached.contains(&block); });
+}
+
+// An empty block that only branches on is left out: its predecessors branch
+// to its successor directly. If the successor has phis, a predecessor that
+// also branches to the successor itself would need two values in them, so
+// the block is kept then.
+bool Simplifier::skip_forwarding() {
+  bool changed = false;
+  auto entry = &this->func.blocks.front();
+  for (auto & block : this->func.blocks) {
+    auto br = std::get_if<ir::Br>(&block.terminator);
+    if (&block == entry || this->removed.contains(&block) || br == nullptr) continue;
+    auto & block_preds = this->preds[&block];
+    if (block_preds.size() == 1) drop_phis(block);
+    auto dest = br->dest;
+    if (!block.body.empty() || dest == &block) continue;
+    auto & dest_preds = this->preds[dest];
+    if (has_phis(*dest) && std::ranges::any_of(block_preds, [&dest_preds](ir::Label pred) {
+      return std::ranges::find(dest_preds, pred) != dest_preds.end();
+    })) continue;
+
+    for (auto pred : block_preds) {
+      foreach_target(pred->terminator, [&block, dest](ir::Label & target) {
+        if (target == &block) target = dest;
+      });
+    }
+    foreach_phi(*dest, [&block, &block_preds](ir::Phi & phi) {
+      auto source = std::ranges::find(phi.sources, &block, [](const auto & source) { return source.second; });
+      auto value = source->first;
+      phi.sources.erase(source);
+      for (auto pred : block_preds) {
+        phi.sources.emplace_back(value, pred);
+      }
+    });
+    dest_preds.erase(std::ranges::find(dest_preds, &block));
+    dest_preds.insert(dest_preds.end(), block_preds.begin(), block_preds.end());
+    this->preds.erase(&block);
+    this->removed.insert(&block);
+    changed = true;
+  }
+  return changed;
+}
+
+// A block that is the only predecessor of its only successor takes the
+// successor's instructions and terminator.
+bool Simplifier::merge_chains() {
+  bool changed = false;
+  auto entry = &this->func.blocks.front();
+  for (auto & block : this->func.blocks) {
+    if (this->removed.contains(&block)) continue;
+    while (auto br = std::get_if<ir::Br>(&block.terminator)) {
+      auto next = br->dest;
+      if (next == &block || next == entry || this->preds[next].size() != 1) break;
+
+      drop_phis(*next);
+      block.body.splice(block.body.end(), next->body);
+      block.terminator = std::move(next->terminator);
+      foreach_target(block.terminator, [this, &block, next](ir::Label target) {
+        std::ranges::replace(this->preds[target], next, &block);
+        foreach_phi(*target, [&block, next](ir::Phi & phi) {
+          for (auto & source : phi.sources) {
+            if (source.second == next) source.second = &block;
+          }
+        });
+      });
+      this->preds.erase(next);
+      this->removed.insert(next);
+      changed = true;
+    }
+  }
+  return changed;
+}
+
+// with a single predecessor, each phi of `block` has one source,
+// which replaces it
+void Simplifier::drop_phis(ir::Block & block) {
+  while (has_phis(block)) {
+    auto phi = block.body.begin();
+    ir::Operand value = std::get<ir::Phi>(*phi).sources.front().first;
+    replace_all_uses_with(*phi, value);
+    erase_if_dead(block, phi);
+  }
+}
+
+void simplify_cfg(ir::Func & func) {
+  Simplifier simplifier{func};
+  simplifier.remove_unreachable();
+  bool changed = true;
+  while (changed) {
+    changed = simplifier.skip_forwarding();
+    changed = simplifier.merge_chains() || changed;
+  }
+  func.blocks.remove_if([&simplifier](ir::Block & block) { return simplifier.removed.contains(&block); });
+}
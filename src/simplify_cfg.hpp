@@ -0,0 +1,9 @@
+#pragma once
+
+#include "ir.hpp"
+
+// Simplifies the control flow graph of `func`, keeping its phis valid:
+// removes the blocks that can't be reached from the entry, skips empty
+// blocks that only branch on to another one, and merges a block into its
+// predecessor when it is the only successor of a predecessor it only has.
+void simplify_cfg(ir::Func & func);
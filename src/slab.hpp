@@ -0,0 +1,215 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "arena.hpp"
+
+// Objects of the types `Ts` that are created and destroyed one by one, but
+// whose memory is only released with the slab, a few blocks at once.
+// Objects never move; the room of a destroyed object is reused by the next
+// object of its type.
+template<typename... Ts>
+struct Slab {
+private:
+  struct FreeSlot {
+    FreeSlot * next;
+  };
+
+  // A slab usually holds a single function, most of which are small, so
+  // blocks start small and each only adds a quarter to the slab.
+  static constexpr std::size_t first_block_size = 1024;
+  static constexpr unsigned growth_shift = 2;
+
+  Arena arena{first_block_size, growth_shift};
+  // the destroyed objects of each type
+  std::array<FreeSlot *, sizeof...(Ts)> free{};
+
+  template<typename T>
+  static constexpr std::size_t index_of() {
+    constexpr std::array<bool, sizeof...(Ts)> same{std::is_same_v<T, Ts>...};
+    constexpr auto index = std::size_t(std::ranges::find(same, true) - same.begin());
+    static_assert(index < sizeof...(Ts), "not a type of this slab");
+    return index;
+  }
+
+public:
+  Slab() = default;
+  Slab(const Slab &) = delete;
+  Slab & operator=(const Slab &) = delete;
+  // objects point into the slab, which therefore stays where it is
+  Slab(Slab &&) = delete;
+  Slab & operator=(Slab &&) = delete;
+  // objects still alive are not destroyed
+  ~Slab() = default;
+
+  template<typename T, typename... Args>
+  T * make(Args &&... args) {
+    static_assert(sizeof(T) >= sizeof(FreeSlot) && alignof(T) >= alignof(FreeSlot));
+    auto & free = this->free[index_of<T>()];
+    void * room = free;
+    if (free != nullptr) {
+      free = free->next;
+    } else {
+      room = this->arena.room_for<T>();
+    }
+    return ::new (room) T(std::forward<Args>(args)...);
+  }
+
+  template<typename T>
+  void destroy(T * object) {
+    auto & free = this->free[index_of<T>()];
+    object->~T();
+    free = ::new (static_cast<void *>(object)) FreeSlot{free};
+  }
+};
+
+struct SlabLink {
+  SlabLink * prev;
+  SlabLink * next;
+};
+
+template<typename T>
+struct SlabNode : SlabLink {
+  T value;
+
+  template<typename... Args>
+  explicit SlabNode(Args &&... args) : SlabLink{}, value(std::forward<Args>(args)...) {}
+};
+
+// A doubly linked list whose nodes live in a `Slab` it may share with other
+// lists; elements can be spliced between the lists sharing one. As with
+// std::list, elements never move and an iterator stays valid until its
+// element is erased. The list is a ring through its sentinel, so stepping
+// back from `begin()` gives `end()`, and stepping on from there `begin()`.
+template<typename T, typename Storage>
+struct SlabList {
+  using Node = SlabNode<T>;
+
+  template<bool Const>
+  struct Iterator {
+    using iterator_category = std::bidirectional_iterator_tag;
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::conditional_t<Const, const T *, T *>;
+    using reference = std::conditional_t<Const, const T &, T &>;
+
+    SlabLink * link = nullptr;
+
+    Iterator() = default;
+    explicit Iterator(SlabLink * link) : link(link) {}
+    // NOLINTNEXTLINE(google-explicit-constructor)
+    operator Iterator<true>() const requires (!Const) { return Iterator<true>(link); }
+
+    reference operator*() const { return static_cast<Node *>(link)->value; }
+    pointer operator->() const { return &**this; }
+    Iterator & operator++() { link = link->next; return *this; }
+    Iterator & operator--() { link = link->prev; return *this; }
+    Iterator operator++(int) { auto old = *this; ++*this; return old; }
+    Iterator operator--(int) { auto old = *this; --*this; return old; }
+    bool operator==(const Iterator & other) const = default;
+  };
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+private:
+  SlabLink head;
+  Storage * storage;
+
+  // puts the nodes from `first` to `last` before `pos`
+  static void link_before(SlabLink * pos, SlabLink * first, SlabLink * last) {
+    first->prev = pos->prev;
+    last->next = pos;
+    pos->prev->next = first;
+    pos->prev = last;
+  }
+  // takes the nodes from `first` to `last` out of their list
+  static void unlink(SlabLink * first, SlabLink * last) {
+    first->prev->next = last->next;
+    last->next->prev = first->prev;
+  }
+  SlabLink * sentinel() const { return const_cast<SlabLink *>(&head); } // NOLINT(cppcoreguidelines-pro-type-const-cast)
+
+public:
+  explicit SlabList(Storage & storage) : head{&head, &head}, storage(&storage) {}
+  SlabList(const SlabList &) = delete;
+  SlabList & operator=(const SlabList &) = delete;
+  // the first and last nodes point to the sentinel
+  SlabList(SlabList &&) = delete;
+  SlabList & operator=(SlabList &&) = delete;
+  ~SlabList() { clear(); }
+
+  iterator begin() { return iterator(head.next); }
+  iterator end() { return iterator(&head); }
+  const_iterator begin() const { return const_iterator(head.next); }
+  const_iterator end() const { return const_iterator(sentinel()); }
+
+  [[nodiscard]] bool empty() const { return head.next == &head; }
+  T & front() { return *begin(); }
+  const T & front() const { return *begin(); }
+  T & back() { return *--end(); }
+  const T & back() const { return *--end(); }
+
+  template<typename... Args>
+  iterator emplace(const_iterator pos, Args &&... args) {
+    Node * node = storage->template make<Node>(std::forward<Args>(args)...);
+    link_before(pos.link, node, node);
+    return iterator(node);
+  }
+  iterator insert(const_iterator pos, T && value) {
+    return emplace(pos, std::move(value));
+  }
+  template<typename... Args>
+  T & emplace_front(Args &&... args) {
+    return *emplace(begin(), std::forward<Args>(args)...);
+  }
+  template<typename... Args>
+  T & emplace_back(Args &&... args) {
+    return *emplace(end(), std::forward<Args>(args)...);
+  }
+
+  // returns the element after the erased one
+  iterator erase(const_iterator pos) {
+    SlabLink * next = pos.link->next;
+    unlink(pos.link, pos.link);
+    storage->destroy(static_cast<Node *>(pos.link));
+    return iterator(next);
+  }
+  void pop_back() { erase(--end()); }
+  void clear() {
+    while (!empty()) erase(begin());
+  }
+
+  template<typename Pred>
+  std::size_t remove_if(Pred pred) {
+    std::size_t count = 0;
+    for (auto it = begin(); it != end();) {
+      if (pred(*it)) {
+        it = erase(it);
+        count++;
+      } else {
+        ++it;
+      }
+    }
+    return count;
+  }
+
+  // moves the elements of `other`, which must share the slab, before `pos`
+  void splice(const_iterator pos, SlabList & other) {
+    if (other.empty()) return;
+    SlabLink * first = other.head.next;
+    SlabLink * last = other.head.prev;
+    unlink(first, last);
+    link_before(pos.link, first, last);
+  }
+  // moves the element at `it` of `other`, which must share the slab, before `pos`
+  void splice(const_iterator pos, SlabList & /* other */, const_iterator it) {
+    unlink(it.link, it.link);
+    link_before(pos.link, it.link, it.link);
+  }
+};
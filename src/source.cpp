@@ -0,0 +1,66 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "source.hpp"
+
+Source::Source() : data(nullptr), length(0), mapped(false) {}
+
+Source Source::map_file(const char * path) {
+  int fd = open(path, O_RDONLY); // NOLINT(cppcoreguidelines-pro-type-vararg)
+  if (fd < 0) throw "can't open input file";
+  struct stat st {};
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw "can't stat input file";
+  }
+  Source result;
+  // mmap refuses empty mappings; an empty file is just an empty buffer
+  if (st.st_size > 0) {
+    void * addr = mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) { // NOLINT(cppcoreguidelines-pro-type-cstyle-cast)
+      close(fd);
+      throw "can't map input file";
+    }
+    // the lexer reads front to back exactly once
+    madvise(addr, std::size_t(st.st_size), MADV_SEQUENTIAL);
+    result.data = static_cast<const char *>(addr);
+    result.length = std::size_t(st.st_size);
+    result.mapped = true;
+  }
+  close(fd);
+  return result;
+}
+
+Source Source::read_all(std::istream & in) {
+  constexpr std::size_t chunk = std::size_t(1) << 16;
+  Source result;
+  while (in.good()) {
+    std::size_t filled = result.owned.size();
+    result.owned.resize(filled + chunk);
+    in.read(result.owned.data() + filled, chunk); // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    result.owned.resize(filled + std::size_t(in.gcount()));
+  }
+  result.data = result.owned.data();
+  result.length = result.owned.size();
+  return result;
+}
+
+Source::Source(Source && other) noexcept
+  : data(other.data), length(other.length), mapped(other.mapped),
+    owned(std::move(other.owned)) {
+  // a moved std::string may have moved its buffer or kept it inline
+  if (!mapped) {
+    data = owned.data();
+  }
+  other.data = nullptr;
+  other.length = 0;
+  other.mapped = false;
+}
+
+Source::~Source() {
+  if (mapped) {
+    munmap(const_cast<char *>(data), length); // NOLINT(cppcoreguidelines-pro-type-const-cast)
+  }
+}
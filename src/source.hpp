@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <string>
+
+// The whole input as one contiguous, read-only buffer.
+// Files are memory-mapped; streams are read in one go.
+struct Source {
+private:
+  const char * data;
+  std::size_t length;
+  // whether `data` points to a mapping that must be unmapped
+  bool mapped;
+  // backing storage when the input was read from a stream
+  std::string owned;
+
+  Source();
+
+public:
+  static Source map_file(const char * path);
+  static Source read_all(std::istream & in);
+
+  Source(const Source &) = delete;
+  Source(Source && other) noexcept;
+  Source & operator=(const Source &) = delete;
+  Source & operator=(Source && other) = delete;
+  ~Source();
+
+  [[nodiscard]] inline const char * begin() const { return data; }
+  [[nodiscard]] inline const char * end() const { return data + length; } // NOLINT(cppcoreguidelines-pro-bounds-pointer-arithmetic)
+  [[nodiscard]] inline std::size_t size() const { return length; }
+};
@@ -0,0 +1,133 @@
+#include <optional>
+
+#include "ssa_builder.hpp"
+
+void SsaBuilder::clear() {
+  this->defs.clear();
+  this->blocks.clear();
+  this->phis.clear();
+  this->replaced.clear();
+}
+
+std::uint32_t SsaBuilder::new_var() {
+  this->defs.emplace_back();
+  return std::uint32_t(this->defs.size() - 1);
+}
+
+void SsaBuilder::write(std::uint32_t var, ir::Label block, ir::Operand value) {
+  this->defs[var][block] = value;
+}
+
+ir::Operand SsaBuilder::read(std::uint32_t var, ir::Label block) {
+  // a straight line of blocks is followed without recursion
+  std::vector<ir::Label> path;
+  ir::Operand value;
+  while (true) {
+    auto & defs = this->defs[var];
+    if (auto def = defs.find(block); def != defs.end()) {
+      value = resolve(def->second);
+      break;
+    }
+    auto & state = this->blocks[block];
+    if (!state.sealed || state.preds.size() != 1) {
+      value = read_recursive(var, block);
+      break;
+    }
+    path.push_back(block);
+    block = state.preds.front();
+  }
+  // remembered on the way, so the next read stops earlier
+  for (auto visited : path) {
+    write(var, visited, value);
+  }
+  return value;
+}
+
+ir::Operand SsaBuilder::read_recursive(std::uint32_t var, ir::Label block) {
+  auto & state = this->blocks[block];
+  ir::Operand value;
+  if (!state.sealed) {
+    auto phi = new_phi(block);
+    state.incomplete.emplace_back(var, phi);
+    value = phi;
+  } else if (state.preds.empty()) {
+    // unreachable, or read before any assignment
+    value = ir::Const{0};
+  } else {
+    // written first, to end loops in the CFG
+    auto phi = new_phi(block);
+    write(var, block, phi);
+    value = add_phi_operands(var, block, phi);
+  }
+  write(var, block, value);
+  return value;
+}
+
+ir::InstrRef SsaBuilder::new_phi(ir::Label block) {
+  auto phi = block->push_front(ir::Phi{ir::I32});
+  this->phis.push_back(PhiState{block, phi});
+  return phi;
+}
+
+ir::Operand SsaBuilder::add_phi_operands(std::uint32_t var, ir::Label block, ir::InstrRef phi) {
+  // `blocks` may rehash while reading
+  auto preds = this->blocks[block].preds;
+  for (auto pred : preds) {
+    auto value = read(var, pred);
+    std::get<ir::Phi>(*phi).sources.emplace_back(value, pred);
+  }
+  return try_remove_trivial(phi);
+}
+
+// A phi is trivial if it merges only one value besides itself; it is then
+// replaced by that value. Its users may become trivial in turn, which
+// `finish` takes care of.
+ir::Operand SsaBuilder::try_remove_trivial(ir::InstrRef phi) {
+  std::optional<ir::Operand> same;
+  for (auto & [source, _] : std::get<ir::Phi>(*phi).sources) {
+    auto value = resolve(source);
+    if (value == ir::Operand(phi) || (same.has_value() && value == *same)) continue;
+    if (same.has_value()) return phi;
+    same = value;
+  }
+  // no value besides itself: the variable is never assigned on the way
+  auto value = same.value_or(ir::Const{0});
+  this->replaced[&*phi] = value;
+  return value;
+}
+
+ir::Operand SsaBuilder::resolve(ir::Operand value) const {
+  while (auto result = value.get_if<ir::Result>()) {
+    auto it = this->replaced.find(&**result);
+    if (it == this->replaced.end()) break;
+    value = it->second;
+  }
+  return value;
+}
+
+void SsaBuilder::seal(ir::Label block, std::vector<ir::Label> && preds) {
+  auto & state = this->blocks[block];
+  state.preds = std::move(preds);
+  state.sealed = true;
+  auto incomplete = std::move(state.incomplete);
+  for (auto [var, phi] : incomplete) {
+    add_phi_operands(var, block, phi);
+  }
+}
+
+void SsaBuilder::finish() {
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto & state : this->phis) {
+      if (this->replaced.contains(&*state.phi)) continue;
+      changed = try_remove_trivial(state.phi) != ir::Operand(state.phi) || changed;
+    }
+  }
+
+  for (auto & state : this->phis) {
+    if (!this->replaced.contains(&*state.phi)) continue;
+    replace_all_uses_with(*state.phi, resolve(state.phi));
+    erase_if_dead(*state.block, state.phi);
+  }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "ir.hpp"
+
+// Builds SSA form for local variables while their function is generated,
+// after Braun et al., "Simple and Efficient Construction of Static Single
+// Assignment Form". Each block records the value each variable has at its
+// end. A read looks the value up through the predecessors, and creates a phi
+// where they meet. A block is sealed once all its predecessors are known.
+// Before that, reading in it creates a phi whose operands are only added on
+// sealing. A phi that only merges one value is replaced by that value.
+struct SsaBuilder {
+private:
+  struct BlockState {
+    bool sealed = false;
+    std::vector<ir::Label> preds;
+    // variables read before the block was sealed, and the phi for each
+    std::vector<std::pair<std::uint32_t, ir::InstrRef>> incomplete;
+  };
+  struct PhiState {
+    ir::Label block;
+    ir::InstrRef phi;
+  };
+
+  // the value of each variable at the end of each block that defines it
+  std::vector<std::unordered_map<ir::Label, ir::Operand>> defs;
+  std::unordered_map<ir::Label, BlockState> blocks;
+  std::vector<PhiState> phis;
+  // trivial phis and the value each was replaced by
+  std::unordered_map<const ir::Instr *, ir::Operand> replaced;
+
+  ir::Operand read_recursive(std::uint32_t var, ir::Label block);
+  ir::InstrRef new_phi(ir::Label block);
+  ir::Operand add_phi_operands(std::uint32_t var, ir::Label block, ir::InstrRef phi);
+  ir::Operand try_remove_trivial(ir::InstrRef phi);
+  [[nodiscard]] ir::Operand resolve(ir::Operand value) const;
+
+public:
+  // forgets the variables and blocks of the previous function
+  void clear();
+  // a new variable, with no value yet
+  std::uint32_t new_var();
+
+  void write(std::uint32_t var, ir::Label block, ir::Operand value);
+  ir::Operand read(std::uint32_t var, ir::Label block);
+  // `preds` are all the predecessors `block` will have
+  void seal(ir::Label block, std::vector<ir::Label> && preds);
+  // removes the phis that became trivial since they were created, after
+  // replacing their uses; every block must be sealed
+  void finish();
+};
@@ -0,0 +1,38 @@
+#include "symbol_table.hpp"
+
+// enough for the globals and locals of small programs without rehashing
+static constexpr std::size_t initial_slots = 64;
+
+SymbolTable::SymbolTable() : slots(initial_slots, Slot{Sym{none}, none}), scopes{0} {}
+
+void SymbolTable::grow() {
+  auto old = std::move(this->slots);
+  this->slots.assign(old.size() * 2, Slot{Sym{none}, none});
+  for (auto & slot : old) {
+    if (slot.name.id != none) this->slots[slot_of(slot.name)] = slot;
+  }
+}
+
+void SymbolTable::pop_scope() {
+  auto begin = this->scopes.back();
+  this->scopes.pop_back();
+  while (this->decls.size() > begin) {
+    auto & decl = this->decls.back();
+    this->slots[slot_of(decl.name)].decl = decl.shadowed;
+    this->decls.pop_back();
+  }
+}
+
+bool SymbolTable::declare(Sym name, const Symbol & symbol) {
+  // keep at most half of the slots used, so probes stay short
+  if (2 * (this->used_slots + 1) > this->slots.size()) grow();
+  auto & slot = this->slots[slot_of(name)];
+  if (slot.decl != none && slot.decl >= this->scopes.back()) return false;
+  if (slot.name.id == none) {
+    slot.name = name;
+    this->used_slots++;
+  }
+  this->decls.push_back(Decl{name, symbol, slot.decl});
+  slot.decl = std::uint32_t(this->decls.size() - 1);
+  return true;
+}
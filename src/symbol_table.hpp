@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "intern.hpp"
+#include "ir.hpp"
+
+struct Symbol {
+  enum Kind {
+    CONST, VAR, FUNC,
+    // a local variable kept in SSA form instead of memory
+    LOCAL
+  } kind;
+  ir::Type type; // int or void
+  int argc; // currently only int args are supported
+  ir::Operand ir;
+  // LOCAL: the variable in the SsaBuilder of its function
+  std::uint32_t local = 0;
+};
+
+// The symbols of all open scopes in one open-addressing hash table, with
+// a slot per name for its innermost visible declaration. Declarations are
+// kept on a stack, each linked to the one it shadows, so entering a scope
+// is free and leaving it only undoes the declarations made in it. Finding
+// a name costs the same however deeply scopes are nested.
+struct SymbolTable {
+public:
+  static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+private:
+  struct Decl {
+    Sym name;
+    Symbol symbol;
+    // the declaration of the same name this one shadows, or none
+    std::uint32_t shadowed;
+  };
+  struct Slot {
+    // none for an empty slot
+    Sym name;
+    // the innermost declaration of `name`, or none if it isn't visible
+    std::uint32_t decl;
+  };
+
+  std::vector<Decl> decls;
+  // a power of two in size; slots are never removed, only made invisible
+  std::vector<Slot> slots;
+  std::size_t used_slots = 0;
+  // the size of `decls` where each open scope begins
+  std::vector<std::uint32_t> scopes;
+
+  [[nodiscard]] inline std::size_t slot_of(Sym name) const {
+    // Fibonacci hashing spreads the ids, which share their low bits by shard
+    constexpr std::uint64_t multiplier = 0x9E3779B97F4A7C15;
+    std::size_t mask = this->slots.size() - 1;
+    auto i = std::size_t((name.id * multiplier) >> 32U) & mask;
+    while (this->slots[i].name.id != none && this->slots[i].name != name) {
+      i = (i + 1) & mask;
+    }
+    return i;
+  }
+  void grow();
+
+public:
+  // with one scope open
+  SymbolTable();
+
+  // the number of declarations in all open scopes
+  [[nodiscard]] inline std::uint32_t size() const {
+    return std::uint32_t(this->decls.size());
+  }
+  [[nodiscard]] inline std::size_t depth() const {
+    return this->scopes.size();
+  }
+  inline void push_scope() {
+    this->scopes.push_back(std::uint32_t(this->decls.size()));
+  }
+  void pop_scope();
+
+  // false if `name` is already declared in the innermost scope
+  bool declare(Sym name, const Symbol & symbol);
+
+  // index of the innermost visible declaration of `name`, or none;
+  // indices count declarations in order, from 0
+  [[nodiscard]] inline std::uint32_t find(Sym name) const {
+    return this->slots[slot_of(name)].decl;
+  }
+  [[nodiscard]] inline const Symbol & operator[](std::uint32_t decl) const {
+    return this->decls[decl].symbol;
+  }
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+
+#include <sys/resource.h>
+
+// Reports the wall time of each driver phase on stderr, when enabled,
+// together with the peak resident set size so far.
+struct PhaseTimer {
+private:
+  using Clock = std::chrono::steady_clock;
+  bool enabled;
+  Clock::time_point last;
+
+public:
+  inline PhaseTimer(bool enabled_) : enabled(enabled_), last(Clock::now()) {}
+
+  // ends the current phase; with `bytes`, also reports its throughput
+  inline void lap(const char * phase, std::size_t bytes = 0) {
+    auto now = Clock::now();
+    if (enabled) {
+      double ms = std::chrono::duration<double, std::milli>(now - last).count();
+      std::cerr << phase << ": " << ms << " ms";
+      if (bytes != 0 && ms > 0) {
+        constexpr double mega = 1e6;
+        constexpr double per_second = 1e3;
+        std::cerr << " (" << double(bytes) / mega / (ms / per_second) << " MB/s)";
+      }
+      rusage usage {};
+      getrusage(RUSAGE_SELF, &usage);
+      constexpr long kilo = 1024;
+      std::cerr << ", peak rss " << usage.ru_maxrss / kilo << " MB" << std::endl;
+    }
+    last = Clock::now();
+  }
+};
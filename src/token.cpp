@@ -6,31 +6,11 @@
 
 // NOLINTBEGIN(cppcoreguidelines-pro-type-member-init)
 Token::Token() : tag(ERR) {}
-Token::Token(std::string && ident) : tag(IDENT), ident(std::move(ident)) {}
+Token::Token(Sym ident) : tag(IDENT), ident(ident) {}
 Token::Token(int number) : tag(NUMBER), number(number) {}
 Token::Token(Tag tag_) : tag(tag_) {}
 // NOLINTEND(cppcoreguidelines-pro-type-member-init)
 
-Token::Token(Token && other) noexcept : tag(other.tag) {
-  switch (other.tag) {
-  case IDENT: new(&ident) std::string{std::move(other.ident)}; break;
-  case NUMBER: number = other.number; break;
-  default: break;
-  }
-}
-
-Token & Token::operator=(Token && other) noexcept {
-  this->~Token();
-  new(this) Token(std::move(other));
-  return *this;
-}
-
-Token::~Token() {
-  if (tag == IDENT) {
-    ident.std::string::~string();
-  }
-}
-
 std::ostream & operator<<(std::ostream & out, const Token & tok) {
   switch (tok.tag) {
   case Token::IDENT: out << "Ident(" << tok.ident << ")"; break;
@@ -65,8 +45,6 @@ std::ostream & operator<<(std::ostream & out, const Token & tok) {
   case Token::AND: out << "And"; break;
   case Token::OR: out << "Or"; break;
   case Token::NOT: out << "Not"; break;
-  case Token::COMMENT: out << "Comment"; break;
-  case Token::SPACE: out << "Space"; break;
   case Token::ERR: out << "Err"; break;
   }
   return out;
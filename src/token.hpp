@@ -1,8 +1,10 @@
-#include <string>
+#include <cstdint>
+#include <iosfwd>
+
+#include "intern.hpp"
 
-// NOLINTNEXTLINE(cppcoreguidelines-special-member-functions)
 struct Token {
-  enum Tag {
+  enum Tag : std::uint8_t {
     IDENT,
     NUMBER,
     IF, ELSE, WHILE, BREAK, CONTINUE, RETURN, CONST,
@@ -15,25 +17,17 @@ struct Token {
     PLUS, MINUS, MULT, DIV, MOD,
     LT, LTEQ, GT, GTEQ, EQ, NEQ,
     AND, OR, NOT,
-    COMMENT,
-    SPACE,
     ERR
   } tag;
   union {
-    std::string ident;
+    Sym ident;
     int number;
   };
 
   Token();
-  Token(std::string && ident);
+  Token(Sym ident);
   Token(int number);
   Token(Tag tag_);
-
-  Token(Token && other) noexcept;
-
-  ~Token();
-
-  Token & operator=(Token && other) noexcept;
 };
 
 std::ostream & operator<<(std::ostream & out, const Token & tok);
@@ -0,0 +1,19 @@
+define dso_local i32 @main() {
+    %1 = alloca i32
+    store i32 1, ptr %1
+    br label %2
+
+2:
+    %3 = icmp ne i32 1, 0
+    br i1 %3, label %4, label %7
+
+4:
+    %5 = load i32, ptr %1
+    %6 = add i32 %5, 1
+    store i32 %6, ptr %1
+    br label %2
+
+7:
+    %8 = load i32, ptr %1
+    ret i32 %8
+}
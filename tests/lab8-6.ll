@@ -0,0 +1,40 @@
+declare void @putch(i32)
+declare void @putint(i32)
+@unused = dso_local global i32 3
+@used = dso_local global i32 4
+define dso_local i32 @twice(i32 %0) {
+    %2 = mul i32 %0, 2
+    ret i32 %2
+}
+define dso_local i32 @count(i32 %0) {
+    %2 = icmp eq i32 %0, 0
+    br i1 %2, label %3, label %5
+
+3:
+    ret i32 0
+
+4:
+    br label %5
+
+5:
+    %6 = sub i32 %0, 1
+    %7 = call i32 @count(i32 %6)
+    %8 = add i32 %7, 1
+    ret i32 %8
+}
+define dso_local i32 @show(i32 %0) {
+    call void @putch(i32 %0)
+    %2 = call i32 @count(i32 %0)
+    %3 = load i32, ptr @unused
+    %4 = add i32 %2, %3
+    ret i32 %4
+}
+define dso_local i32 @main() {
+    %1 = alloca i32
+    %2 = load i32, ptr @used
+    %3 = call i32 @twice(i32 %2)
+    store i32 %3, ptr %1
+    %4 = load i32, ptr %1
+    call void @putint(i32 %4)
+    ret i32 0
+}
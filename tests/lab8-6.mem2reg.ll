@@ -0,0 +1,12 @@
+declare void @putint(i32)
+@used = dso_local global i32 4
+define dso_local i32 @twice(i32 %0) {
+    %2 = mul i32 %0, 2
+    ret i32 %2
+}
+define dso_local i32 @main() {
+    %1 = load i32, ptr @used
+    %2 = call i32 @twice(i32 %1)
+    call void @putint(i32 %2)
+    ret i32 0
+}
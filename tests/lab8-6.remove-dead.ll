@@ -0,0 +1,15 @@
+declare void @putint(i32)
+@used = dso_local global i32 4
+define dso_local i32 @twice(i32 %0) {
+    %2 = mul i32 %0, 2
+    ret i32 %2
+}
+define dso_local i32 @main() {
+    %1 = alloca i32
+    %2 = load i32, ptr @used
+    %3 = call i32 @twice(i32 %2)
+    store i32 %3, ptr %1
+    %4 = load i32, ptr %1
+    call void @putint(i32 %4)
+    ret i32 0
+}